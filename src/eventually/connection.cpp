@@ -13,6 +13,12 @@ namespace eventually {
         _interrupt_flag.store(false);
     }
 
+    connection_data::connection_data(const std::shared_ptr<connection_data>& parent):
+    _parent(parent)
+    {
+        _interrupt_flag.store(false);
+    }
+
 
     void connection_data::interrupt() NOEXCEPT
     {
@@ -21,35 +27,109 @@ namespace eventually {
 
     void connection_data::interruption_point()
     {
-        if(_interrupt_flag.load())
+        if(interrupted())
         {
             throw connection_interrupted();
         }
     }
 
+    bool connection_data::interrupted() const NOEXCEPT
+    {
+        for(auto data = this; data != nullptr; data = data->_parent.get())
+        {
+            if(data->_interrupt_flag.load())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     connection::connection():
     _data(std::make_shared<connection_data>())
     {
     }
 
+    connection::connection(std::nullptr_t) NOEXCEPT
+    {
+    }
+
     connection::~connection()
     {
-        std::lock_guard<std::mutex> lock(get_mutex());
+        std::lock_guard<connection> lock(*this);
+    }
+
+    connection connection::child() const
+    {
+        connection c(nullptr);
+        c._data = std::make_shared<connection_data>(_data);
+        return c;
     }
 
     void connection::interrupt() NOEXCEPT
     {
-        _data->interrupt();
+        if(_data)
+        {
+            _data->interrupt();
+        }
     }
 
     void connection::interruption_point()
     {
-        _data->interruption_point();
+        if(_data)
+        {
+            _data->interruption_point();
+        }
+    }
+
+    bool connection::interrupted() const NOEXCEPT
+    {
+        return _data && _data->interrupted();
     }
 
     std::mutex& connection::get_mutex() NOEXCEPT
     {
-        return _data->_mutex;
+        static std::mutex null_mutex;
+        return _data ? _data->_mutex : null_mutex;
+    }
+
+    void connection::lock()
+    {
+        if(_data)
+        {
+            _data->_mutex.lock();
+        }
+    }
+
+    void connection::unlock() NOEXCEPT
+    {
+        if(_data)
+        {
+            _data->_mutex.unlock();
+        }
+    }
+
+    weak_connection::weak_connection() NOEXCEPT
+    {
+    }
+
+    weak_connection::weak_connection(const connection& c) NOEXCEPT:
+    _data(c._data)
+    {
+    }
+
+    void weak_connection::interrupt() const NOEXCEPT
+    {
+        if(auto data = _data.lock())
+        {
+            data->interrupt();
+        }
+    }
+
+    bool weak_connection::interrupted() const NOEXCEPT
+    {
+        auto data = _data.lock();
+        return data && data->interrupted();
     }
 
     scoped_connection::~scoped_connection()
@@ -7,20 +7,28 @@
 #include <exception>
 #include <mutex>
 #include <atomic>
+#include <cstddef>
+#include <type_traits>
 
 namespace eventually {
 
     /**
-     * The shared data between connection handlers
+     * The shared data between connection handlers.
+     * A child keeps its parent alive and checks it when asked
+     * if it is interrupted, so interrupting a parent does not
+     * need to know about its children.
      */
     struct connection_data
     {
         std::atomic_bool _interrupt_flag;
         std::mutex _mutex;
+        std::shared_ptr<connection_data> _parent;
 
         connection_data();
+        explicit connection_data(const std::shared_ptr<connection_data>& parent);
         void interrupt() NOEXCEPT;
         void interruption_point();
+        bool interrupted() const NOEXCEPT;
     };
 
     /**
@@ -32,19 +40,63 @@ namespace eventually {
         virtual const char* what() const THROW;
     };
 
+    class weak_connection;
+
     /**
      * A handler class for interrupting dispatched works.
+     * It can be locked to wait for the work to finish.
      */
     class connection
     {
     private:
+        friend class weak_connection;
         std::shared_ptr<connection_data> _data;
     public:
         connection();
+
+        /**
+         * A connection that can not be interrupted.
+         * It does not allocate any data.
+         */
+        explicit connection(std::nullptr_t) NOEXCEPT;
         virtual ~connection();
+
+        /**
+         * A new connection that is also interrupted when this one is,
+         * or any of its parents. Locking this one does not wait for
+         * the works of the children. A child of a connection that can
+         * not be interrupted is a normal connection.
+         */
+        connection child() const;
         void interrupt() NOEXCEPT;
         void interruption_point();
-        std::mutex& get_mutex() NOEXCEPT;
+        bool interrupted() const NOEXCEPT;
+
+        /**
+         * @deprecated lock the connection itself with lock and unlock.
+         * A connection that can not be interrupted has no mutex,
+         * it gets one that is shared by all of them.
+         */
+        DEPRECATED std::mutex& get_mutex() NOEXCEPT;
+        void lock();
+        void unlock() NOEXCEPT;
+    };
+
+    /**
+     * Interrupts the work of a connection without keeping it alive.
+     * It can not be locked and destroying it does not wait for the work,
+     * so it can be stored where the work itself may release it,
+     * like the state of the future that the work fulfills.
+     */
+    class weak_connection
+    {
+    private:
+        std::weak_ptr<connection_data> _data;
+    public:
+        weak_connection() NOEXCEPT;
+        weak_connection(const connection& c) NOEXCEPT;
+        void interrupt() const NOEXCEPT;
+        bool interrupted() const NOEXCEPT;
     };
 
     /**
@@ -56,6 +108,46 @@ namespace eventually {
         virtual ~scoped_connection();
     };
 
+    /**
+     * A connection that can not be interrupted, known at compile time.
+     * Used by the dispatcher functions that do not take a connection,
+     * the tasks that store it do not lock or check for interruption.
+     */
+    class null_connection
+    {
+    public:
+        void interrupt() NOEXCEPT
+        {
+        }
+
+        void interruption_point() NOEXCEPT
+        {
+        }
+
+        bool interrupted() const NOEXCEPT
+        {
+            return false;
+        }
+
+        void lock() NOEXCEPT
+        {
+        }
+
+        void unlock() NOEXCEPT
+        {
+        }
+    };
+
+    /**
+     * True for the types that can be passed as a connection
+     */
+    template<typename Connection>
+    struct is_connection : std::integral_constant<bool,
+        std::is_base_of<connection, Connection>::value ||
+        std::is_same<null_connection, Connection>::value>
+    {
+    };
+
 }
 
 #endif
@@ -0,0 +1,397 @@
+#ifndef _eventually_coro_hpp_
+#define _eventually_coro_hpp_
+
+#include <eventually/dispatcher.hpp>
+#include <eventually/task_pool.hpp>
+
+#if !defined(__cpp_impl_coroutine)
+#error "eventually/coro.hpp needs C++20 coroutines"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/**
+ * C++20 coroutine support, this header is opt in and
+ * the rest of the library does not need it.
+ *
+ * co_await dispatcher.schedule() continues the coroutine in a task of the dispatcher,
+ * co_await on an eventually::future continues it when the future is fulfilled
+ * and co_await on a coro::task starts it and continues when it is done.
+ */
+namespace eventually {
+namespace coro {
+
+    template<typename Result>
+    class task;
+
+    /**
+     * The promise of a coroutine task. The frames are stored in the task pool.
+     * When the coroutine finishes it transfers to the one that awaits it,
+     * so a chain of tasks does not grow the stack.
+     */
+    class task_promise_base
+    {
+    private:
+        std::coroutine_handle<> _continuation;
+        std::exception_ptr _exception;
+
+    protected:
+        void rethrow()
+        {
+            if(_exception)
+            {
+                std::rethrow_exception(_exception);
+            }
+        }
+
+    public:
+        struct final_awaiter
+        {
+            bool await_ready() const NOEXCEPT
+            {
+                return false;
+            }
+
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) NOEXCEPT
+            {
+                auto c = h.promise()._continuation;
+                return c ? c : std::noop_coroutine();
+            }
+
+            void await_resume() NOEXCEPT
+            {
+            }
+        };
+
+        static void* operator new(size_t size)
+        {
+            return task_pool::allocate(size);
+        }
+
+        static void operator delete(void* p, size_t size) NOEXCEPT
+        {
+            task_pool::deallocate(p, size);
+        }
+
+        std::suspend_always initial_suspend() NOEXCEPT
+        {
+            return std::suspend_always();
+        }
+
+        final_awaiter final_suspend() NOEXCEPT
+        {
+            return final_awaiter();
+        }
+
+        void unhandled_exception() NOEXCEPT
+        {
+            _exception = std::current_exception();
+        }
+
+        void set_continuation(std::coroutine_handle<> c) NOEXCEPT
+        {
+            _continuation = c;
+        }
+    };
+
+    template<typename Result>
+    class task_promise : public task_promise_base
+    {
+    private:
+        std::optional<Result> _value;
+
+    public:
+        task<Result> get_return_object() NOEXCEPT;
+
+        template<typename Value>
+        void return_value(Value&& v)
+        {
+            _value.emplace(std::forward<Value>(v));
+        }
+
+        Result get()
+        {
+            rethrow();
+            return std::move(*_value);
+        }
+    };
+
+    template<>
+    class task_promise<void> : public task_promise_base
+    {
+    public:
+        task<void> get_return_object() NOEXCEPT;
+
+        void return_void() NOEXCEPT
+        {
+        }
+
+        void get()
+        {
+            rethrow();
+        }
+    };
+
+    /**
+     * A lazy coroutine that starts when it is awaited
+     * and returns a Result or throws to the awaiting coroutine.
+     * Use spawn to start one from code that is not a coroutine.
+     */
+    template<typename Result=void>
+    class task
+    {
+    public:
+        typedef task_promise<Result> promise_type;
+        typedef std::coroutine_handle<promise_type> handle;
+
+    private:
+        handle _handle;
+
+        task(const task&);
+        task& operator=(const task&);
+
+    public:
+        struct awaiter
+        {
+            handle coroutine;
+
+            bool await_ready() const NOEXCEPT
+            {
+                return !coroutine || coroutine.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) NOEXCEPT
+            {
+                coroutine.promise().set_continuation(h);
+                return coroutine;
+            }
+
+            Result await_resume()
+            {
+                if(!coroutine)
+                {
+                    throw std::future_error(std::future_errc::no_state);
+                }
+                return coroutine.promise().get();
+            }
+        };
+
+        explicit task(handle h=handle()) NOEXCEPT:
+        _handle(h)
+        {
+        }
+
+        task(task&& other) NOEXCEPT:
+        _handle(std::exchange(other._handle, handle()))
+        {
+        }
+
+        task& operator=(task&& other) NOEXCEPT
+        {
+            if(this != &other)
+            {
+                if(_handle)
+                {
+                    _handle.destroy();
+                }
+                _handle = std::exchange(other._handle, handle());
+            }
+            return *this;
+        }
+
+        ~task()
+        {
+            if(_handle)
+            {
+                _handle.destroy();
+            }
+        }
+
+        bool valid() const NOEXCEPT
+        {
+            return (bool)_handle;
+        }
+
+        awaiter operator co_await() const & NOEXCEPT
+        {
+            return awaiter{_handle};
+        }
+
+        awaiter operator co_await() const && NOEXCEPT
+        {
+            return awaiter{_handle};
+        }
+    };
+
+    template<typename Result>
+    task<Result> task_promise<Result>::get_return_object() NOEXCEPT
+    {
+        return task<Result>(task<Result>::handle::from_promise(*this));
+    }
+
+    inline task<void> task_promise<void>::get_return_object() NOEXCEPT
+    {
+        return task<void>(task<void>::handle::from_promise(*this));
+    }
+
+    /**
+     * Awaits an eventually::future. The coroutine continues in the thread
+     * that fulfills the promise, without polling. Futures that have
+     * no completion are waited for in the awaiting thread.
+     */
+    template<typename Result>
+    class future_awaiter
+    {
+    private:
+        future<Result>& _future;
+
+    public:
+        explicit future_awaiter(future<Result>& f) NOEXCEPT:
+        _future(f)
+        {
+        }
+
+        bool await_ready() const NOEXCEPT
+        {
+            return !_future.get_completion() || _future.is_ready();
+        }
+
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            auto resumed = std::allocate_shared<std::atomic_bool>(
+                task_pool_allocator<std::atomic_bool>(), false);
+            auto c = _future.get_completion();
+            c->then([h, resumed](){
+                if(resumed->exchange(true))
+                {
+                    h.resume();
+                }
+            });
+            // then calls the continuation right away if the promise was
+            // fulfilled after await_ready, the second one to get here resumes
+            return !resumed->exchange(true);
+        }
+
+        Result await_resume()
+        {
+            return _future.get();
+        }
+    };
+
+    /**
+     * A coroutine that starts right away and destroys itself
+     * when it is done, used by spawn
+     */
+    struct detached_task
+    {
+        struct promise_type
+        {
+            static void* operator new(size_t size)
+            {
+                return task_pool::allocate(size);
+            }
+
+            static void operator delete(void* p, size_t size) NOEXCEPT
+            {
+                task_pool::deallocate(p, size);
+            }
+
+            detached_task get_return_object() NOEXCEPT
+            {
+                return detached_task();
+            }
+
+            std::suspend_never initial_suspend() NOEXCEPT
+            {
+                return std::suspend_never();
+            }
+
+            std::suspend_never final_suspend() NOEXCEPT
+            {
+                return std::suspend_never();
+            }
+
+            void return_void() NOEXCEPT
+            {
+            }
+
+            void unhandled_exception() NOEXCEPT
+            {
+                std::terminate();
+            }
+        };
+    };
+
+    template<typename Result>
+    detached_task spawn_detached(dispatcher& d, connection c, task<Result> t,
+        promise<Result> p)
+    {
+        try
+        {
+            co_await d.schedule(c);
+            if constexpr(std::is_void<Result>::value)
+            {
+                co_await std::move(t);
+                p.set_value();
+            }
+            else
+            {
+                p.set_value(co_await std::move(t));
+            }
+        }
+        catch(...)
+        {
+            p.set_exception(std::current_exception());
+        }
+    }
+
+    /**
+     * Start a task in a dispatcher and get a future of its result,
+     * that can be used with the dispatcher when functions or awaited.
+     * If the connection is interrupted before the task starts
+     * the future throws connection_interrupted.
+     */
+    template<typename Result>
+    future<Result> spawn(dispatcher& d, connection& c, task<Result>&& t)
+    {
+        promise<Result> p;
+        auto f = p.get_future();
+        spawn_detached(d, c, std::move(t), std::move(p));
+        return f;
+    }
+
+    template<typename Result>
+    future<Result> spawn(dispatcher& d, task<Result>&& t)
+    {
+        connection c(nullptr);
+        return spawn(d, c, std::move(t));
+    }
+
+}
+
+    /**
+     * Found by argument dependent lookup, so futures can be awaited
+     * without using the coro namespace
+     */
+    template<typename Result>
+    coro::future_awaiter<Result> operator co_await(future<Result>& f) NOEXCEPT
+    {
+        return coro::future_awaiter<Result>(f);
+    }
+
+    template<typename Result>
+    coro::future_awaiter<Result> operator co_await(future<Result>&& f) NOEXCEPT
+    {
+        return coro::future_awaiter<Result>(f);
+    }
+
+}
+
+#endif
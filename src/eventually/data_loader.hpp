@@ -1,7 +1,7 @@
 #ifndef _eventually_data_loader_hpp_
 #define _eventually_data_loader_hpp_
 
-#include <future>
+#include <eventually/future.hpp>
 #include <exception>
 #include <string>
 #include <vector>
@@ -32,11 +32,11 @@ namespace eventually {
     /**
      * The type trait to detect a valid data loader.
      * Data loaders should have a method called
-     * `std::future<data_ptr> load(connection& c, const std::string& name)`
+     * `future<data> load(connection& c, const std::string& name)`
      */
     template <typename T>
     using can_load_data = std::is_same<
-      decltype(std::declval<T>().load(*(connection*)nullptr, std::string())), std::future<data>>;
+      decltype(std::declval<T>().load(*(connection*)nullptr, std::string())), future<data>>;
 
     /**
      * The type trait to detect a class that has a dispatcher
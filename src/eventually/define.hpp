@@ -1,13 +1,15 @@
-
-#ifndef _eventually_define_hpp_
-#define _eventually_define_hpp_
-
-#ifndef _MSC_VER
-#define NOEXCEPT noexcept
-#define THROW    throw()
-#else
-#define NOEXCEPT
-#define THROW
-#endif
-
+
+#ifndef _eventually_define_hpp_
+#define _eventually_define_hpp_
+
+#ifndef _MSC_VER
+#define NOEXCEPT noexcept
+#define THROW    throw()
+#define DEPRECATED __attribute__((deprecated))
+#else
+#define NOEXCEPT
+#define THROW
+#define DEPRECATED __declspec(deprecated)
+#endif
+
 #endif
\ No newline at end of file
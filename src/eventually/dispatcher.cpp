@@ -3,8 +3,439 @@
 
 namespace eventually {
 
+    /**
+     * Used by completed futures to push the tasks that were waiting
+     * for them, checking that the dispatcher still exists.
+     */
+    struct dispatcher::link
+    {
+        std::mutex mutex;
+        dispatcher* target;
+
+        link(dispatcher* d):
+        target(d)
+        {
+        }
+
+        void push_task(basic_task_ptr&& t) NOEXCEPT
+        {
+            basic_task_ptr task_(std::move(t));
+            std::lock_guard<std::mutex> lock_(mutex);
+            if(target)
+            {
+                target->push_task(std::move(task_));
+            }
+        }
+    };
+
+    /**
+     * A task waiting for a number of completions
+     */
+    struct pending_task
+    {
+        std::atomic<size_t> count;
+        basic_task_ptr task;
+
+        pending_task(size_t count, basic_task_ptr&& t):
+        count(count), task(std::move(t))
+        {
+        }
+    };
+
+    const dispatcher::clock::duration dispatcher::default_retry_interval = std::chrono::milliseconds(1);
+
+    namespace {
+
+        typedef std::chrono::milliseconds timer_resolution;
+    }
+
+    dispatcher::dispatcher(task_queue* queue):
+    _tasks(queue ? queue : new priority_task_queue()),
+    _link(std::make_shared<link>(this)),
+    _timers_start(clock::now())
+    {
+        _tasks_size.store(0);
+        _tracer.store(nullptr);
+        _timers_next.store(clock::time_point::max().time_since_epoch().count());
+        _waiting_size.store(0);
+        _waiting_sweep.store(0);
+        _waiting_check.store(clock::rep());
+        _retry_interval.store(default_retry_interval.count());
+        _task_cost.store(clock::rep());
+    }
+
     dispatcher::~dispatcher()
     {
+        unlink();
+    }
+
+    void dispatcher::unlink() NOEXCEPT
+    {
+        std::lock_guard<std::mutex> lock_(_link->mutex);
+        _link->target = nullptr;
+    }
+
+    void dispatcher::push_task_when_ready(basic_task_ptr&& t, std::initializer_list<future_completion_ptr> completions) NOEXCEPT
+    {
+        push_task_when_ready(std::move(t), completions.begin(), completions.end());
+    }
+
+    void dispatcher::push_task_when_ready(basic_task_ptr&& t, const std::vector<future_completion_ptr>& completions) NOEXCEPT
+    {
+        push_task_when_ready(std::move(t), completions.data(), completions.data() + completions.size());
+    }
+
+    void dispatcher::push_task_when_ready(basic_task_ptr&& t, const future_completion_ptr* begin, const future_completion_ptr* end) NOEXCEPT
+    {
+        size_t count = 0;
+        for(auto c = begin; c != end; ++c)
+        {
+            if(*c)
+            {
+                ++count;
+            }
+        }
+        if(count == 0)
+        {
+            push_task(std::move(t));
+            return;
+        }
+        auto pending = std::allocate_shared<pending_task>(
+            task_pool_allocator<pending_task>(), count, std::move(t));
+        std::shared_ptr<link> link_ = _link;
+        for(auto c = begin; c != end; ++c)
+        {
+            if(*c)
+            {
+                (*c)->then([pending, link_](){
+                    if(pending->count.fetch_sub(1) == 1)
+                    {
+                        link_->push_task(std::move(pending->task));
+                    }
+                });
+            }
+        }
+    }
+
+    void dispatcher::push_task(basic_task_ptr&& t) NOEXCEPT
+    {
+        record_push(*t);
+        _tasks_size.fetch_add(1);
+        _tasks->push(std::move(t));
+        notify_tasks(1);
+    }
+
+    void dispatcher::push_tasks(std::vector<basic_task_ptr>&& ts) NOEXCEPT
+    {
+        size_t count = ts.size();
+        if(count == 0)
+        {
+            return;
+        }
+        for(auto& t : ts)
+        {
+            record_push(*t);
+        }
+        _tasks_size.fetch_add(count);
+        _tasks->push(std::move(ts));
+        notify_tasks(count);
+    }
+
+    void dispatcher::notify_tasks(size_t count) NOEXCEPT
+    {
+        if(count == 1)
+        {
+            _new_task.notify_one();
+        }
+        else if(count > 1)
+        {
+            _new_task.notify_all();
+        }
+    }
+
+    timer_wheel::tick dispatcher::get_timer_tick(const clock::time_point& time, bool round_up) const NOEXCEPT
+    {
+        if(time <= _timers_start)
+        {
+            return 0;
+        }
+        auto tick = timer_resolution(1);
+        auto elapsed = time - _timers_start;
+        auto ticks = std::chrono::duration_cast<timer_resolution>(elapsed).count();
+        if(round_up && elapsed > std::chrono::duration_cast<clock::duration>(tick * ticks))
+        {
+            ++ticks;
+        }
+        return ticks;
+    }
+
+    void dispatcher::update_timers_next() NOEXCEPT
+    {
+        timer_wheel::tick tick;
+        clock::time_point next = clock::time_point::max();
+        if(_timers && _timers->next(tick))
+        {
+            next = _timers_start + std::chrono::duration_cast<clock::duration>(timer_resolution(tick));
+        }
+        _timers_next.store(next.time_since_epoch().count());
+    }
+
+    void dispatcher::push_timer(const clock::time_point& time, basic_task_ptr&& t) NOEXCEPT
+    {
+        bool earlier = false;
+        {
+            std::lock_guard<std::mutex> lock_(_timers_mutex);
+            clock::rep next = _timers_next.load();
+            if(!_timers)
+            {
+                _timers.reset(new timer_wheel());
+            }
+            _timers->add(get_timer_tick(time, true), std::move(t));
+            update_timers_next();
+            earlier = _timers_next.load() < next;
+        }
+        if(earlier)
+        {
+            // the threads that sleep until the next timer have to wake up sooner
+            notify_tasks(1);
+        }
+    }
+
+    dispatcher::clock::time_point dispatcher::get_next_timer() const NOEXCEPT
+    {
+        return clock::time_point(clock::duration(_timers_next.load()));
+    }
+
+    size_t dispatcher::get_queue_size() const NOEXCEPT
+    {
+        return _tasks_size.load();
+    }
+
+    void dispatcher::set_tracer(tracer* t) NOEXCEPT
+    {
+        _tracer.store(t);
+    }
+
+    void dispatcher::record_push(basic_task& t) NOEXCEPT
+    {
+#ifdef EVENTUALLY_METRICS
+        t.set_push_time(clock::now());
+        _metrics.record_push();
+#endif
+#ifdef EVENTUALLY_TRACE
+        if(tracer* tracer_ = _tracer.load(std::memory_order_relaxed))
+        {
+            tracer_->push(t.get_trace());
+        }
+#endif
+        (void)t;
+    }
+
+    dispatcher_metrics dispatcher::get_metrics() const
+    {
+        dispatcher_metrics m;
+#ifdef EVENTUALLY_METRICS
+        _metrics.get_metrics(m);
+#endif
+        m.queue_size = get_queue_size();
+        m.waiting_size = _waiting_size.load();
+        return m;
+    }
+
+    void dispatcher::pop_timers() NOEXCEPT
+    {
+        if(_timers_next.load() == clock::time_point::max().time_since_epoch().count())
+        {
+            return;
+        }
+        auto now = clock::now();
+        if(now.time_since_epoch().count() < _timers_next.load())
+        {
+            return;
+        }
+        std::vector<basic_task_ptr> expired;
+        {
+            std::lock_guard<std::mutex> lock_(_timers_mutex);
+            _timers->advance(get_timer_tick(now, false), expired);
+            update_timers_next();
+        }
+        size_t count = expired.size();
+        if(count > 0)
+        {
+            for(auto& t : expired)
+            {
+                record_push(*t);
+            }
+            _tasks_size.fetch_add(count);
+            _tasks->push(std::move(expired));
+            notify_tasks(count);
+        }
+    }
+
+    bool dispatcher::pop_task(basic_task_ptr& t) NOEXCEPT
+    {
+        pop_timers();
+        if(pop_waiting_task(t, false))
+        {
+            return true;
+        }
+        if(_tasks->pop(t))
+        {
+            _tasks_size.fetch_sub(1);
+            return true;
+        }
+        // nothing else to do, check the waiting tasks
+        return pop_waiting_task(t, true);
+    }
+
+    bool dispatcher::pop_waiting_task(basic_task_ptr& t, bool idle) NOEXCEPT
+    {
+        if(_waiting_size.load() == 0)
+        {
+            return false;
+        }
+        clock::rep now = clock::now().time_since_epoch().count();
+        if(!idle && _waiting_sweep.load() == 0 && now < _waiting_check.load())
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock_(_waiting_mutex);
+        if(_waiting_tasks.empty())
+        {
+            return false;
+        }
+        if(_waiting_sweep.load() == 0)
+        {
+            if(!idle)
+            {
+                // start a sweep over all the waiting tasks
+                _waiting_sweep.store(_waiting_tasks.size());
+            }
+            _waiting_check.store(now + _retry_interval.load());
+        }
+        if(_waiting_sweep.load() > 0)
+        {
+            _waiting_sweep--;
+        }
+        t = std::move(_waiting_tasks.front());
+        _waiting_tasks.pop_front();
+        _waiting_size.store(_waiting_tasks.size());
+        return true;
+    }
+
+    void dispatcher::wait_task(basic_task_ptr&& t) NOEXCEPT
+    {
+        std::lock_guard<std::mutex> lock_(_waiting_mutex);
+        _waiting_tasks.push_back(std::move(t));
+        _waiting_size.store(_waiting_tasks.size());
+    }
+
+    bool dispatcher::process_task(basic_task_ptr&& t) NOEXCEPT
+    {
+        // the task runs without holding any lock so that
+        // other threads can process the rest of the queue
+#ifdef EVENTUALLY_TRACE
+        tracer::run_scope trace_(_tracer.load(std::memory_order_relaxed), t->get_trace());
+#endif
+#ifdef EVENTUALLY_METRICS
+        auto start = clock::now();
+        bool ready = (*t)();
+        auto end = clock::now();
+        _metrics.record_process(start - t->get_push_time(), end - start, ready);
+#else
+        bool ready = (*t)();
+#endif
+#ifdef EVENTUALLY_TRACE
+        trace_.end(ready);
+#endif
+        if(!ready)
+        {
+            // not ready yet, park it so it does not block the queue
+            wait_task(std::move(t));
+            return false;
+        }
+        return true;
+    }
+
+    bool dispatcher::process_next() NOEXCEPT
+    {
+        basic_task_ptr task_;
+        if(!pop_task(task_))
+        {
+            return false;
+        }
+        return process_task(std::move(task_));
+    }
+
+    bool dispatcher::has_waiting_tasks() const NOEXCEPT
+    {
+        return _waiting_size.load() > 0;
+    }
+
+    void dispatcher::set_retry_interval(const clock::duration& interval) NOEXCEPT
+    {
+        _retry_interval.store(interval.count());
+    }
+
+    dispatcher::clock::duration dispatcher::get_retry_interval() const NOEXCEPT
+    {
+        return clock::duration(_retry_interval.load());
+    }
+
+    void dispatcher::retry_waiting() NOEXCEPT
+    {
+        _waiting_check.store(clock::rep());
+        notify_tasks(1);
+    }
+
+    void dispatcher::purge_tasks(std::vector<basic_task_ptr>& purged) NOEXCEPT
+    {
+        size_t count = _tasks->purge(purged);
+        size_t kept = _tasks_size.fetch_sub(count) - count;
+        if(kept > 0)
+        {
+            // a queue can purge by popping all the tasks and pushing the rest again,
+            // a thread that found it empty meanwhile could be waiting
+            notify_tasks(kept);
+        }
+        {
+            std::lock_guard<std::mutex> lock_(_waiting_mutex);
+            auto last = _waiting_tasks.begin();
+            for(auto itr = _waiting_tasks.begin(); itr != _waiting_tasks.end(); ++itr)
+            {
+                if((*itr)->interrupted())
+                {
+                    purged.push_back(std::move(*itr));
+                }
+                else
+                {
+                    *last++ = std::move(*itr);
+                }
+            }
+            _waiting_tasks.erase(last, _waiting_tasks.end());
+            _waiting_size.store(_waiting_tasks.size());
+            if(_waiting_sweep.load() > _waiting_tasks.size())
+            {
+                _waiting_sweep.store(_waiting_tasks.size());
+            }
+        }
+        std::lock_guard<std::mutex> lock_(_timers_mutex);
+        if(_timers && _timers->purge(purged) > 0)
+        {
+            update_timers_next();
+        }
+    }
+
+    size_t dispatcher::purge_interrupted() NOEXCEPT
+    {
+        std::vector<basic_task_ptr> purged;
+        purge_tasks(purged);
+        // outside of the locks, the continuations of the futures can dispatch
+        for(auto& t : purged)
+        {
+            (*t)();
+        }
+        return purged.size();
     }
 
     bool dispatcher::process_all() NOEXCEPT
@@ -20,17 +451,62 @@ namespace eventually {
 
     bool dispatcher::process_one() NOEXCEPT
     {
-        std::lock_guard<std::mutex> lock_(_mutex);
-        if(!_tasks.empty())
+        basic_task_ptr task_;
+        if(!pop_task(task_))
+        {
+            return false;
+        }
+        // a task that is still not ready only counts if there are others to process
+        return process_task(std::move(task_)) || get_queue_size() > 0;
+    }
+
+    process_report dispatcher::process_until(const clock::time_point& end) NOEXCEPT
+    {
+        process_report report = { 0, 0 };
+        auto now = clock::now();
+        clock::duration cost(_task_cost.load());
+        while(now + cost < end)
         {
-            basic_task_ptr& task_ = _tasks.front();
-            if((*task_)())
+            basic_task_ptr task_;
+            if(!pop_task(task_))
             {
-                _tasks.pop_front();
+                break;
             }
-            return true;
+            bool ran = process_task(std::move(task_));
+            auto after = clock::now();
+            if(ran)
+            {
+                ++report.processed;
+                // moving average that follows changes in the task costs
+                if(cost == clock::duration::zero())
+                {
+                    cost = after - now;
+                }
+                else
+                {
+                    cost += (after - now - cost) / 8;
+                }
+                _task_cost.store(cost.count());
+            }
+            else if(get_queue_size() == 0)
+            {
+                // only waiting tasks are left, do not spin on them
+                break;
+            }
+            now = after;
         }
-        return false;
+        report.remaining = get_queue_size();
+        return report;
+    }
+
+    process_report dispatcher::process_for(const clock::duration& budget) NOEXCEPT
+    {
+        return process_until(clock::now() + budget);
+    }
+
+    dispatcher::clock::duration dispatcher::get_task_cost() const NOEXCEPT
+    {
+        return clock::duration(_task_cost.load());
     }
 
 }
@@ -1,37 +1,223 @@
-
 #ifndef _eventually_dispatcher_hpp_
 #define _eventually_dispatcher_hpp_
 
 #include <eventually/define.hpp>
 #include <eventually/task.hpp>
+#include <eventually/task_queue.hpp>
+#include <eventually/timer_wheel.hpp>
+#include <eventually/metrics.hpp>
+#include <eventually/tracer.hpp>
 #include <eventually/connection.hpp>
+#include <eventually/future.hpp>
 #include <eventually/worker.hpp>
 #include <eventually/is_callable.hpp>
 #include <eventually/is_same.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <initializer_list>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <tuple>
+#include <type_traits>
 
 namespace eventually {
 
+    template<typename Connection, typename Work, typename... Args>
+    class periodic_task;
+
+    /**
+     * What a call to process_for or process_until did
+     */
+    struct process_report
+    {
+        /**
+         * tasks that were run
+         */
+        size_t processed;
+
+        /**
+         * tasks left in the queue, without the waiting tasks and the timers
+         */
+        size_t remaining;
+    };
+
     /**
      * This is a base class for an object that provides std::async like functionality.
      * It stores a list of function objects to be processed some time in the future.
+     * Tasks whose retry function returns false are parked in a waiting list that
+     * is checked when there is nothing else to do, every retry interval
+     * or when retry_waiting is called.
+     * Delayed tasks are stored in a timer wheel with a resolution of one
+     * millisecond and queued when their time is reached.
      */
     class dispatcher
     {
+    public:
+        typedef std::chrono::steady_clock clock;
+
     private:
-        typedef std::unique_ptr<basic_task> basic_task_ptr;
-        std::mutex _mutex;
-        std::deque<basic_task_ptr> _tasks;
+        struct link;
+
+        template<typename Connection, typename Work, typename... Args>
+        friend class periodic_task;
+        friend class strand;
+
+        std::unique_ptr<task_queue> _tasks;
+        std::atomic<size_t> _tasks_size;
+        std::mutex _waiting_mutex;
+        std::deque<basic_task_ptr> _waiting_tasks;
+        std::atomic<size_t> _waiting_size;
+        std::atomic<size_t> _waiting_sweep;
+        std::atomic<clock::rep> _waiting_check;
+        std::atomic<clock::rep> _retry_interval;
+        std::atomic<clock::rep> _task_cost;
+        std::shared_ptr<link> _link;
+        std::mutex _timers_mutex;
+        std::unique_ptr<timer_wheel> _timers;
+        clock::time_point _timers_start;
+        std::atomic<clock::rep> _timers_next;
+        // the layout does not depend on EVENTUALLY_METRICS and EVENTUALLY_TRACE,
+        // only the recording does
+        metrics_recorder _metrics;
+        std::atomic<tracer*> _tracer;
+
+        bool pop_task(basic_task_ptr& t) NOEXCEPT;
+        void pop_timers() NOEXCEPT;
+        timer_wheel::tick get_timer_tick(const clock::time_point& time, bool round_up) const NOEXCEPT;
+        void update_timers_next() NOEXCEPT;
+        bool pop_waiting_task(basic_task_ptr& t, bool idle) NOEXCEPT;
+        void wait_task(basic_task_ptr&& t) NOEXCEPT;
+
+        /**
+         * Push the task when all the completions are done. Tasks waiting
+         * for futures without a completion are pushed right away.
+         */
+        void push_task_when_ready(basic_task_ptr&& t, std::initializer_list<future_completion_ptr> completions) NOEXCEPT;
+        void push_task_when_ready(basic_task_ptr&& t, const std::vector<future_completion_ptr>& completions) NOEXCEPT;
+        void push_task_when_ready(basic_task_ptr&& t, const future_completion_ptr* begin, const future_completion_ptr* end) NOEXCEPT;
 
     protected:
         std::condition_variable _new_task;
 
+        /**
+         * Add a new task to be processed
+         */
+        virtual void push_task(basic_task_ptr&& t) NOEXCEPT;
+
+        /**
+         * Add a list of tasks to be processed in one go
+         */
+        virtual void push_tasks(std::vector<basic_task_ptr>&& ts) NOEXCEPT;
+
+        /**
+         * Wake up the threads waiting for new tasks,
+         * by default all of them if there is more than one task
+         */
+        virtual void notify_tasks(size_t count) NOEXCEPT;
+
+        /**
+         * Run a task that was taken out of a queue,
+         * if it is not ready it is parked in the waiting list
+         * @return false if the task was not ready
+         */
+        bool process_task(basic_task_ptr&& t) NOEXCEPT;
+
+        /**
+         * Like process_one but only returns true if a task was run,
+         * so that threads can go to sleep while the waiting tasks are not ready
+         */
+        bool process_next() NOEXCEPT;
+
+        bool has_waiting_tasks() const NOEXCEPT;
+
+        /**
+         * Count and trace a task that is added to a queue,
+         * does nothing without EVENTUALLY_METRICS or EVENTUALLY_TRACE
+         */
+        void record_push(basic_task& t) NOEXCEPT;
+
+        /**
+         * Queue a task when a time point is reached,
+         * the timer wheel is created with the first timer
+         */
+        virtual void push_timer(const clock::time_point& time, basic_task_ptr&& t) NOEXCEPT;
+
+        /**
+         * Get the time of the next timer,
+         * clock::time_point::max() if there are none
+         */
+        clock::time_point get_next_timer() const NOEXCEPT;
+
+        /**
+         * Move the tasks whose connection was interrupted out of the queue,
+         * the waiting list and the timers. Dispatchers with more
+         * queues add their tasks too.
+         */
+        virtual void purge_tasks(std::vector<basic_task_ptr>& purged) NOEXCEPT;
+
+        /**
+         * Stop accepting tasks from completed futures.
+         * Subclasses that override push_task should call this
+         * at the start of their destructor.
+         */
+        void unlink() NOEXCEPT;
+
     public:
 
+        /**
+         * @param queue where the tasks are stored, the dispatcher takes ownership.
+         * If null a priority_task_queue is used.
+         */
+        dispatcher(task_queue* queue=nullptr);
         virtual ~dispatcher();
 
+        static const clock::duration default_retry_interval;
+
+        /**
+         * Set how often the waiting tasks are checked
+         * while there are other tasks in the queue
+         */
+        void set_retry_interval(const clock::duration& interval) NOEXCEPT;
+        clock::duration get_retry_interval() const NOEXCEPT;
+
+        /**
+         * Check all the waiting tasks in the next calls to process_one.
+         * Call it when something that a retry function depends on changes.
+         */
+        void retry_waiting() NOEXCEPT;
+
+        /**
+         * Remove the tasks that did not start and whose connection
+         * was interrupted, for example with a parent connection.
+         * Their futures throw connection_interrupted and the works do not run.
+         * Tasks waiting for futures are removed when these are met.
+         * @return the amount of tasks that were removed
+         */
+        size_t purge_interrupted() NOEXCEPT;
+
+        /**
+         * Approximate amount of tasks in the queue, without
+         * the waiting tasks and the timers that did not expire
+         */
+        size_t get_queue_size() const NOEXCEPT;
+
+        /**
+         * Get a snapshot of the counters and histograms of the dispatcher.
+         * Only the queue sizes are filled if the library
+         * was built without EVENTUALLY_METRICS.
+         */
+        dispatcher_metrics get_metrics() const;
+
+        /**
+         * Record the tasks in a tracer, null to stop.
+         * The tracer has to outlive the tasks that are recorded.
+         * Does nothing if the library was built without EVENTUALLY_TRACE.
+         */
+        void set_tracer(tracer* t) NOEXCEPT;
+
         /**
          * Do work in the future
          * @param connection that is used to interrupt the work
@@ -40,17 +226,42 @@ namespace eventually {
          */
         template<typename Work, typename... Args,
             typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
-        auto dispatch(Work&& w, Args&&... args) NOEXCEPT -> std::future<decltype(w(std::forward<Args>(args)...))>
+        auto dispatch(Work&& w, Args&&... args) NOEXCEPT -> future<decltype(w(std::forward<Args>(args)...))>
         {
-            connection c;
+            null_connection c;
             return dispatch(c, std::forward<Work>(w), std::forward<Args>(args)...);
         }
 
+        template<typename Connection, typename Work, typename... Args,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
+        auto dispatch(Connection& c, Work&& w, Args&&... args) NOEXCEPT -> future<decltype(w(std::forward<Args>(args)...))>
+        {
+            return dispatch(task_priority::normal, c, std::forward<Work>(w), std::forward<Args>(args)...);
+        }
+
+        /**
+         * Do work in the future with a priority, only the queues that support it
+         * (like the default priority_task_queue) process high priority tasks first
+         * @param priority of the task
+         * @param connection that is used to interrupt the work
+         * @param work function
+         * @param args additional arguments
+         */
         template<typename Work, typename... Args,
             typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
-        auto dispatch(connection& c, Work&& w, Args&&... args) NOEXCEPT -> std::future<decltype(w(std::forward<Args>(args)...))>
+        auto dispatch(task_priority p, Work&& w, Args&&... args) NOEXCEPT -> future<decltype(w(std::forward<Args>(args)...))>
+        {
+            null_connection c;
+            return dispatch(p, c, std::forward<Work>(w), std::forward<Args>(args)...);
+        }
+
+        template<typename Connection, typename Work, typename... Args,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
+        auto dispatch(task_priority p, Connection& c, Work&& w, Args&&... args) NOEXCEPT -> future<decltype(w(std::forward<Args>(args)...))>
         {
-            return dispatch_retry(c, [](Args&... args){
+            return dispatch_retry(p, c, [](Args&... args){
                 return true;
             }, std::forward<Work>(w), std::forward<Args>(args)...);
         }
@@ -67,71 +278,262 @@ namespace eventually {
             typename std::enable_if<is_callable<Retry(Args&...)>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
         auto dispatch_retry(Retry&& r, Work&& w, Args&&... args) NOEXCEPT
-            -> std::future<decltype(w(std::forward<Args>(args)...))>
+            -> future<decltype(w(std::forward<Args>(args)...))>
         {
-            connection c;
+            null_connection c;
             return dispatch_retry(c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...);
         }
 
+        template<typename Connection, typename Retry, typename Work, typename... Args,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Retry(Args&...)>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
+        auto dispatch_retry(Connection& c, Retry&& r, Work&& w, Args&&... args) NOEXCEPT
+            -> future<decltype(w(std::forward<Args>(args)...))>
+        {
+            return dispatch_retry(task_priority::normal, c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...);
+        }
+
         template<typename Retry, typename Work, typename... Args,
             typename std::enable_if<is_callable<Retry(Args&...)>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
-        auto dispatch_retry(connection& c, Retry&& r, Work&& w, Args&&... args) NOEXCEPT
-            -> std::future<decltype(w(std::forward<Args>(args)...))>
+        auto dispatch_retry(task_priority p, Retry&& r, Work&& w, Args&&... args) NOEXCEPT
+            -> future<decltype(w(std::forward<Args>(args)...))>
+        {
+            null_connection c;
+            return dispatch_retry(p, c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...);
+        }
+
+        template<typename Connection, typename Retry, typename Work, typename... Args,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Retry(Args&...)>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
+        auto dispatch_retry(task_priority p, Connection& c, Retry&& r, Work&& w, Args&&... args) NOEXCEPT
+            -> future<decltype(w(std::forward<Args>(args)...))>
         {
             auto t = make_task_ptr(c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...);
+            t->set_priority(p);
             auto f = t->get_future();
-            std::lock_guard<std::mutex> lock_(_mutex);
-            _tasks.push_back(std::move(t));
-            _new_task.notify_one();
+            push_task(std::move(t));
             return f;
         }
 
         /**
-         * Do work in the future checking if futures are ready
+         * Do work when a time point is reached
+         * @param time when the task is queued
          * @param connection that is used to interrupt the work
          * @param work function
          * @param args additional arguments
          */
-        template <typename Work, typename... Results,
-            typename std::enable_if<is_callable<Work(std::future<Results>&&...)>::value, int>::type = 0>
-        auto dispatch_future(Work&& w, std::future<Results>&&... fs) NOEXCEPT
-            -> std::future<decltype(w(std::move(fs)...))>
+        template<typename Work, typename... Args,
+            typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
+        auto dispatch_at(const clock::time_point& time, Work&& w, Args&&... args) NOEXCEPT
+            -> future<decltype(w(std::forward<Args>(args)...))>
         {
-            connection c;
-            return dispatch_future(c, std::forward<Work>(w), std::move(fs)...);
+            null_connection c;
+            return dispatch_at(time, c, std::forward<Work>(w), std::forward<Args>(args)...);
+        }
+
+        template<typename Connection, typename Work, typename... Args,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
+        auto dispatch_at(const clock::time_point& time, Connection& c, Work&& w, Args&&... args) NOEXCEPT
+            -> future<decltype(w(std::forward<Args>(args)...))>
+        {
+            auto t = make_task_ptr(c, [](Args&... args){
+                return true;
+            }, std::forward<Work>(w), std::forward<Args>(args)...);
+            auto f = t->get_future();
+            push_timer(time, std::move(t));
+            return f;
+        }
+
+        /**
+         * Do work after some time
+         * @param delay after which the task is queued
+         * @param connection that is used to interrupt the work
+         * @param work function
+         * @param args additional arguments
+         */
+        template<typename Work, typename... Args,
+            typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
+        auto dispatch_after(const clock::duration& delay, Work&& w, Args&&... args) NOEXCEPT
+            -> future<decltype(w(std::forward<Args>(args)...))>
+        {
+            return dispatch_at(clock::now() + delay, std::forward<Work>(w), std::forward<Args>(args)...);
+        }
+
+        template<typename Connection, typename Work, typename... Args,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(Args&&...)>::value, int>::type = 0>
+        auto dispatch_after(const clock::duration& delay, Connection& c, Work&& w, Args&&... args) NOEXCEPT
+            -> future<decltype(w(std::forward<Args>(args)...))>
+        {
+            return dispatch_at(clock::now() + delay, c, std::forward<Work>(w), std::forward<Args>(args)...);
+        }
+
+        /**
+         * Do work every period until the connection is interrupted.
+         * Periods that were missed because the dispatcher was busy are skipped.
+         * @param period time between the works, the first one is after a period
+         * @param connection that is used to stop
+         * @param work function, if it throws the future gets the exception and it stops
+         * @param args additional arguments copied and passed to every call
+         * @result future that throws connection_interrupted when stopped
+         */
+        template<typename Connection, typename Work, typename... Args,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(typename std::decay<Args>::type&...)>::value, int>::type = 0>
+        future<void> dispatch_every(const clock::duration& period, Connection& c, Work&& w, Args&&... args) NOEXCEPT
+        {
+            typedef periodic_task<Connection, typename std::decay<Work>::type, typename std::decay<Args>::type...> task_type;
+            auto now = clock::now();
+            std::unique_ptr<task_type> t(new task_type(*this, c, period, now + period,
+                std::forward<Work>(w), std::forward<Args>(args)...));
+            auto f = t->get_future();
+            push_timer(now + period, std::move(t));
+            return f;
+        }
+
+        /**
+         * Do work in the future for every element of a range.
+         * All the tasks are queued at once and the work function is copied to each one.
+         * @param connection that is used to interrupt all the works
+         * @param first iterator to the first element
+         * @param last iterator past the last element
+         * @param work function that accepts an element
+         * @result a future for every element
+         */
+        template<typename Iterator, typename Work,
+            typename std::enable_if<is_callable<Work(typename std::iterator_traits<Iterator>::value_type&&)>::value, int>::type = 0>
+        auto dispatch_range(Iterator first, Iterator last, Work&& w) NOEXCEPT
+            -> std::vector<future<typename result_of<Work(typename std::iterator_traits<Iterator>::value_type&&)>::type>>
+        {
+            null_connection c;
+            return dispatch_range(c, first, last, std::forward<Work>(w));
+        }
+
+        template<typename Connection, typename Iterator, typename Work,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(typename std::iterator_traits<Iterator>::value_type&&)>::value, int>::type = 0>
+        auto dispatch_range(Connection& c, Iterator first, Iterator last, Work&& w) NOEXCEPT
+            -> std::vector<future<typename result_of<Work(typename std::iterator_traits<Iterator>::value_type&&)>::type>>
+        {
+            typedef typename std::iterator_traits<Iterator>::value_type value;
+            typedef typename std::decay<Work>::type work;
+            typedef typename result_of<Work(value&&)>::type result;
+            std::vector<basic_task_ptr> tasks;
+            std::vector<future<result>> fs;
+            for(; first != last; ++first)
+            {
+                auto t = make_task_ptr(c, [](value&){
+                    return true;
+                }, work(w), value(*first));
+                fs.push_back(t->get_future());
+                tasks.push_back(std::move(t));
+            }
+            push_tasks(std::move(tasks));
+            return fs;
+        }
+
+        /**
+         * Do work in the future a number of times.
+         * All the tasks are queued at once and the work function is copied to each one.
+         * @param connection that is used to interrupt all the works
+         * @param count amount of tasks
+         * @param work function that accepts the index of the task
+         * @result a future for every task
+         */
+        template<typename Work,
+            typename std::enable_if<is_callable<Work(size_t&&)>::value, int>::type = 0>
+        auto dispatch_bulk(size_t count, Work&& w) NOEXCEPT
+            -> std::vector<future<typename result_of<Work(size_t&&)>::type>>
+        {
+            null_connection c;
+            return dispatch_bulk(c, count, std::forward<Work>(w));
         }
 
-        template <typename Work, typename... Results,
-            typename std::enable_if<is_callable<Work(std::future<Results>&&...)>::value, int>::type = 0>
-        auto dispatch_future(connection& c, Work&& w, std::future<Results>&&... fs) NOEXCEPT
-            -> std::future<decltype(w(std::move(fs)...))>
+        template<typename Connection, typename Work,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(size_t&&)>::value, int>::type = 0>
+        auto dispatch_bulk(Connection& c, size_t count, Work&& w) NOEXCEPT
+            -> std::vector<future<typename result_of<Work(size_t&&)>::type>>
         {
-            return dispatch_retry(c, [](std::future<Results>&... fs){
+            typedef typename std::decay<Work>::type work;
+            typedef typename result_of<Work(size_t&&)>::type result;
+            std::vector<basic_task_ptr> tasks;
+            std::vector<future<result>> fs;
+            tasks.reserve(count);
+            fs.reserve(count);
+            for(size_t i=0; i<count; ++i)
+            {
+                auto t = make_task_ptr(c, [](size_t&){
                     return true;
+                }, work(w), size_t(i));
+                fs.push_back(t->get_future());
+                tasks.push_back(std::move(t));
+            }
+            push_tasks(std::move(tasks));
+            return fs;
+        }
+
+        /**
+         * Do work in the future when a list of futures are ready.
+         * The task is queued when the tasks that fulfill the futures are done,
+         * futures that were not returned by a dispatcher are retried until ready.
+         * @param connection that is used to interrupt the work
+         * @param work function
+         * @param futures passed to the work function
+         */
+        template <typename Work, typename... Futures,
+            typename std::enable_if<is_future<Futures...>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(Futures&&...)>::value, int>::type = 0>
+        auto dispatch_future(Work&& w, Futures&&... fs) NOEXCEPT
+            -> future<decltype(w(std::move(fs)...))>
+        {
+            null_connection c;
+            return dispatch_future(c, std::forward<Work>(w), std::move(fs)...);
+        }
+
+        template <typename Connection, typename Work, typename... Futures,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_future<Futures...>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(Futures&&...)>::value, int>::type = 0>
+        auto dispatch_future(Connection& c, Work&& w, Futures&&... fs) NOEXCEPT
+            -> future<decltype(w(std::move(fs)...))>
+        {
+            std::initializer_list<future_completion_ptr> completions = { get_future_completion(fs)... };
+            auto t = make_task_ptr(c, [](Futures&... fs){
+                    return when_worker::is_ready(fs...);
                 },
                 std::forward<Work>(w), std::move(fs)...);
+            auto f = t->get_future();
+            push_task_when_ready(std::move(t), completions);
+            return f;
         }
 
         /**
          * Call a function when a future is ready.
          * Can be used to concatenate tasks.
          * @param work function that accepts the future result as a parameter
-         * @param future to wait for         
+         * @param future to wait for
          * @result future for this task
          */
-        template <typename Work, typename Result, typename std::enable_if<is_callable<Work(Result)>::value, int>::type = 0>
-        auto when(Work&& w, std::future<Result>&& f) NOEXCEPT -> std::future<decltype(w(f.get()))>
+        template <typename Work, typename Future,
+            typename std::enable_if<is_callable<Work(future_result_t<Future>)>::value, int>::type = 0>
+        auto when(Work&& w, Future&& f) NOEXCEPT -> future<decltype(w(f.get()))>
         {
-            connection c;
+            null_connection c;
             return when(c, std::forward<Work>(w), std::move(f));
         }
 
-        template <typename Work, typename Result, typename std::enable_if<is_callable<Work(Result)>::value, int>::type = 0>
-        auto when(connection& c, Work&& w, std::future<Result>&& f) NOEXCEPT -> std::future<decltype(w(f.get()))>
+        template <typename Connection, typename Work, typename Future,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(future_result_t<Future>)>::value, int>::type = 0>
+        auto when(Connection& c, Work&& w, Future&& f) NOEXCEPT -> future<decltype(w(f.get()))>
         {
             return dispatch_future(c,
-                [w](std::future<Result>&& f) mutable {
+                [w](typename std::decay<Future>::type&& f) mutable {
                     return when_worker::work(w, f);
                 },
             std::move(f));
@@ -140,24 +542,27 @@ namespace eventually {
         /**
          * Call a function when a future throws an exception
          * Can be used to react to asyncronous exception
-         * @param work function that accepts the exception as a parameter         
+         * @param work function that accepts the exception as a parameter
          * @param future to wait for
          * @result future for this task
-         */         
-        template <typename Exception = std::exception, typename Work, typename Result,
+         */
+        template <typename Exception = std::exception, typename Work, typename Future,
+            typename std::enable_if<is_future<Future>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work(const Exception&)>::value, int>::type = 0>
-        auto when_throw(Work&& w, std::future<Result>&& f) NOEXCEPT -> std::future<Result>
+        auto when_throw(Work&& w, Future&& f) NOEXCEPT -> future<future_result_t<Future>>
         {
-            connection c;
+            null_connection c;
             return when_throw<Exception>(c, std::forward<Work>(w), std::move(f));
         }
 
-        template <typename Exception = std::exception, typename Work, typename Result,
+        template <typename Exception = std::exception, typename Connection, typename Work, typename Future,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_future<Future>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work(const Exception&)>::value, int>::type = 0>
-        auto when_throw(connection& c, Work&& w, std::future<Result>&& f) NOEXCEPT -> std::future<Result>
+        auto when_throw(Connection& c, Work&& w, Future&& f) NOEXCEPT -> future<future_result_t<Future>>
         {
             return dispatch_future(c,
-                [w](std::future<Result>&& f) mutable {
+                [w](typename std::decay<Future>::type&& f) mutable {
                     return when_throw_worker::work<Exception>(w, f);
                 },
             std::move(f));
@@ -171,149 +576,197 @@ namespace eventually {
          * @param future to wait for
          * @result future for this task
          */
-        template <typename Work, typename Result, typename Exception = std::exception,
-            typename std::enable_if<is_callable_with_result<Work(const Exception&), Result>::value, int>::type = 0>
-        auto when_throw_continue(Work&& w, std::future<Result>&& f) NOEXCEPT -> std::future<Result>
+        template <typename Work, typename Future, typename Exception = std::exception,
+            typename std::enable_if<is_callable_with_result<Work(const Exception&), future_result_t<Future>>::value, int>::type = 0>
+        auto when_throw_continue(Work&& w, Future&& f) NOEXCEPT -> future<future_result_t<Future>>
         {
-            connection c;
+            null_connection c;
             return when_throw_continue(c, std::forward<Work>(w), std::move(f));
         }
 
-        template <typename Work, typename Result, typename Exception = std::exception,
-            typename std::enable_if<is_callable_with_result<Work(const Exception&), Result>::value, int>::type = 0>
-        auto when_throw_continue(connection& c, Work&& w, std::future<Result>&& f) NOEXCEPT -> std::future<Result>
+        template <typename Connection, typename Work, typename Future, typename Exception = std::exception,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable_with_result<Work(const Exception&), future_result_t<Future>>::value, int>::type = 0>
+        auto when_throw_continue(Connection& c, Work&& w, Future&& f) NOEXCEPT -> future<future_result_t<Future>>
         {
             return dispatch_future(c,
-                [w](std::future<Result>&& f) mutable {
+                [w](typename std::decay<Future>::type&& f) mutable {
                     return when_throw_continue_worker::work(w, f);
                 },
             std::move(f));
-        }            
+        }
 
         /**
          * Call a function when a a list of futures are met
-         * @param work function that accepts results as parameters         
+         * @param work function that accepts results as parameters
          * @param futures to wait for
          * @result future for this task
          */
-        template <typename Work, typename... Results,
-            typename std::enable_if<is_callable<Work(Results...)>::value, int>::type = 0>
-        auto when_all(Work&& w, std::future<Results>&&... f) NOEXCEPT -> std::future<decltype(w(f.get()...))>
+        template <typename Work, typename... Futures,
+            typename std::enable_if<is_callable<Work(future_result_t<Futures>...)>::value, int>::type = 0>
+        auto when_all(Work&& w, Futures&&... f) NOEXCEPT -> future<decltype(w(f.get()...))>
         {
-            connection c;
+            null_connection c;
             return when_all(c, std::forward<Work>(w), std::move(f)...);
         }
 
-        template <typename Work, typename... Results,
-            typename std::enable_if<is_callable<Work(Results...)>::value, int>::type = 0>
-        auto when_all(connection& c, Work&& w, std::future<Results>&&... f) NOEXCEPT -> std::future<decltype(w(f.get()...))>
+        template <typename Connection, typename Work, typename... Futures,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(future_result_t<Futures>...)>::value, int>::type = 0>
+        auto when_all(Connection& c, Work&& w, Futures&&... f) NOEXCEPT -> future<decltype(w(f.get()...))>
         {
             return dispatch_future(c,
-                [w](std::future<Results>&&... f) mutable {
+                [w](typename std::decay<Futures>::type&&... f) mutable {
                     return when_worker::work(w, f...);
                 },
             std::move(f)...);
         }
 
-        template <typename... Results>
-        auto when_all(std::future<Results>&&... f) NOEXCEPT -> std::future<std::tuple<Results...>>
+        template <typename... Futures,
+            typename std::enable_if<is_future<Futures...>::value, int>::type = 0>
+        auto when_all(Futures&&... f) NOEXCEPT -> future<std::tuple<future_result_t<Futures>...>>
         {
-            connection c;
+            null_connection c;
             return when_all(c, std::move(f)...);
         }
 
-        template <typename... Results>
-        auto when_all(connection& c, std::future<Results>&&... f) NOEXCEPT -> std::future<std::tuple<Results...>>
+        template <typename Connection, typename... Futures,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_future<Futures...>::value, int>::type = 0>
+        auto when_all(Connection& c, Futures&&... f) NOEXCEPT -> future<std::tuple<future_result_t<Futures>...>>
         {
-            return when_all(c, [](Results... rs){
-                return std::tuple<Results...>(rs...);
+            return when_all(c, [](future_result_t<Futures>... rs){
+                return std::tuple<future_result_t<Futures>...>(rs...);
             }, std::move(f)...);
         }
 
+        /**
+         * Wait for a list of futures of the same type,
+         * for example the ones returned by dispatch_bulk
+         * @param futures to wait for
+         * @result future for a vector of results, or void
+         */
+        template <typename Future,
+            typename std::enable_if<is_future<Future>::value, int>::type = 0>
+        auto when_all(std::vector<Future>&& fs) NOEXCEPT
+            -> future<typename when_worker::all_result<future_result_t<Future>>::type>
+        {
+            null_connection c;
+            return when_all(c, std::move(fs));
+        }
+
+        template <typename Connection, typename Future,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_future<Future>::value, int>::type = 0>
+        auto when_all(Connection& c, std::vector<Future>&& fs) NOEXCEPT
+            -> future<typename when_worker::all_result<future_result_t<Future>>::type>
+        {
+            std::vector<future_completion_ptr> completions;
+            completions.reserve(fs.size());
+            for(auto& f : fs)
+            {
+                completions.push_back(get_future_completion(f));
+            }
+            auto t = make_task_ptr(c, [](std::vector<Future>& fs){
+                    return when_worker::is_ready(fs);
+                }, [](std::vector<Future>&& fs){
+                    return when_worker::get_all(fs);
+                }, std::move(fs));
+            auto f = t->get_future();
+            push_task_when_ready(std::move(t), completions);
+            return f;
+        }
+
         /**
          * Call a function when a the first future of a list is met
-         * Only works with a list of futures of the same type
+         * Only works with a list of futures of the same type.
+         * The futures that lose are not waited for and the connections
+         * of their work are interrupted, see future::interrupt.
          * @param work function that accepts a result as parameter
          * @param futures to wait for
          * @result future for this task
          */
-        template <typename Work, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
-            typename std::enable_if<is_callable<Work(Result)>::value, int>::type = 0>
-        auto when_any(Work&& w, std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT -> std::future<decltype(w(f.get()))>
+        template <typename Work, typename Future, typename... Futures,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(future_result_t<Future>)>::value, int>::type = 0>
+        auto when_any(Work&& w, Future&& f, Futures&&... fs) NOEXCEPT -> future<decltype(w(f.get()))>
         {
-            connection c;
+            null_connection c;
             return when_any(c, std::forward<Work>(w), std::move(f), std::move(fs)...);
         }
 
-        template <typename Work, typename FinalResult, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
-            typename std::enable_if<is_callable_with_result<Work(Result), FinalResult>::value, int>::type = 0>
-        void when_any(Work&& w, when_any_worker<FinalResult> p, std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT
+        template <typename Work, typename FinalResult, typename Connection, typename Future, typename... Futures,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
+            typename std::enable_if<is_callable_with_result<Work(future_result_t<Future>), FinalResult>::value, int>::type = 0>
+        void when_any(Work&& w, when_any_worker<FinalResult, Connection> p, Future&& f, Futures&&... fs) NOEXCEPT
         {
             when_any(std::forward<Work>(w), p, std::move(fs)...);
             when_any(std::forward<Work>(w), p, std::move(f));
         }
 
-        template <typename Work, typename FinalResult, typename Result,
-            typename std::enable_if<is_callable_with_result<Work(Result), FinalResult>::value, int>::type = 0>
-        void when_any(Work&& w, when_any_worker<FinalResult> p, std::future<Result> f) NOEXCEPT
+        template <typename Work, typename FinalResult, typename Connection, typename Future,
+            typename std::enable_if<is_callable_with_result<Work(future_result_t<Future>), FinalResult>::value, int>::type = 0>
+        void when_any(Work&& w, when_any_worker<FinalResult, Connection> p, Future&& f) NOEXCEPT
         {
+            auto branch = p.add_branch(get_future_connection(f));
             dispatch_future(
-                [w, p](std::future<Result>&& f) mutable {
-                    return p.work(w, f);
+                [w, p, branch](typename std::decay<Future>::type&& f) mutable {
+                    return p.work(w, f, branch);
                 },
             std::move(f));
         }
 
-        template <typename Work, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
-            typename std::enable_if<is_callable<Work(Result)>::value, int>::type = 0>
-        auto when_any(connection& c, Work&& w, std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT -> std::future<decltype(w(f.get()))>
+        template <typename Connection, typename Work, typename Future, typename... Futures,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(future_result_t<Future>)>::value, int>::type = 0>
+        auto when_any(Connection& c, Work&& w, Future&& f, Futures&&... fs) NOEXCEPT -> future<decltype(w(f.get()))>
         {
-            when_any_worker<decltype(w(f.get()))> p(sizeof...(Results)+1, c);
+            when_any_worker<decltype(w(f.get())), Connection> p(sizeof...(Futures)+1, c);
             when_any(std::forward<Work>(w), p, std::move(f), std::move(fs)...);
             return p.get_future();
         }
 
         // special cases for void futures
-        template <typename Work, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, void>::value, int>::type = 0,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
+        template <typename Work, typename Future, typename... Futures,
+            typename std::enable_if<is_same<future_result_t<Future>, void>::value, int>::type = 0,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work()>::value, int>::type = 0>
-        auto when_any(Work&& w, std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT -> std::future<decltype(w())>
+        auto when_any(Work&& w, Future&& f, Futures&&... fs) NOEXCEPT -> future<decltype(w())>
         {
-            connection c;
+            null_connection c;
             return when_any(c, std::forward<Work>(w), std::move(f), std::move(fs)...);
         }
 
-        template <typename Work, typename FinalResult, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, void>::value, int>::type = 0,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
+        template <typename Work, typename FinalResult, typename Connection, typename Future, typename... Futures,
+            typename std::enable_if<is_same<future_result_t<Future>, void>::value, int>::type = 0,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
             typename std::enable_if<is_callable_with_result<Work(), FinalResult>::value, int>::type = 0>
-        void when_any(Work&& w, when_any_worker<FinalResult> p, std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT
+        void when_any(Work&& w, when_any_worker<FinalResult, Connection> p, Future&& f, Futures&&... fs) NOEXCEPT
         {
             when_any(std::forward<Work>(w), p, std::move(fs)...);
             when_any(std::forward<Work>(w), p, std::move(f));
         }
 
-        template <typename Work, typename FinalResult, typename Result,
-            typename std::enable_if<is_same<Result, void>::value, int>::type = 0,
+        template <typename Work, typename FinalResult, typename Connection, typename Future,
+            typename std::enable_if<is_same<future_result_t<Future>, void>::value, int>::type = 0,
             typename std::enable_if<is_callable_with_result<Work(), FinalResult>::value, int>::type = 0>
-        void when_any(Work&& w, when_any_worker<FinalResult> p, std::future<Result> f) NOEXCEPT
+        void when_any(Work&& w, when_any_worker<FinalResult, Connection> p, Future&& f) NOEXCEPT
         {
-            dispatch_future([w, p](std::future<Result>&& f) mutable {
-                return p.work(w, f);
+            auto branch = p.add_branch(get_future_connection(f));
+            dispatch_future([w, p, branch](typename std::decay<Future>::type&& f) mutable {
+                return p.work(w, f, branch);
             }, std::move(f));
-        }        
+        }
 
-        template <typename Work, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, void>::value, int>::type = 0,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
+        template <typename Connection, typename Work, typename Future, typename... Futures,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_same<future_result_t<Future>, void>::value, int>::type = 0,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work()>::value, int>::type = 0>
-        auto when_any(connection& c, Work&& w, std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT -> std::future<decltype(w())>
+        auto when_any(Connection& c, Work&& w, Future&& f, Futures&&... fs) NOEXCEPT -> future<decltype(w())>
         {
-            when_any_worker<decltype(w())> p(sizeof...(Results)+1, c);
+            when_any_worker<decltype(w()), Connection> p(sizeof...(Futures)+1, c);
             when_any(std::forward<Work>(w), p, std::move(f), std::move(fs)...);
             return p.get_future();
         }
@@ -325,57 +778,311 @@ namespace eventually {
          * @param futures to wait for
          * @result future for this task
          */
-        template <typename Work, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
-            typename std::enable_if<is_callable<Work(when_every_container<Result>&)>::value, int>::type = 0>
-        auto when_every(Work&& w, std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT -> when_every_future<Result>
+        template <typename Work, typename Future, typename... Futures,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(when_every_container<future_result_t<Future>>&)>::value, int>::type = 0>
+        auto when_every(Work&& w, Future&& f, Futures&&... fs) NOEXCEPT -> when_every_future<future_result_t<Future>>
         {
-            connection c;
+            null_connection c;
             return when_every(c, std::forward<Work>(w), std::move(f), std::move(fs)...);
         }
 
-        template <typename Work, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
+        template <typename Work, typename Result, typename Connection, typename Future, typename... Futures,
+            typename std::enable_if<is_same<Result, future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work(when_every_container<Result>&)>::value, int>::type = 0>
-        void when_every(Work&& w, when_every_worker<Result> p, std::future<Result> f, std::future<Results>... fs) NOEXCEPT
+        void when_every(Work&& w, when_every_worker<Result, Connection> p, Future&& f, Futures&&... fs) NOEXCEPT
         {
             when_every(std::forward<Work>(w), p, std::move(fs)...);
             when_every(std::forward<Work>(w), p, std::move(f));
         }
 
-        template <typename Work, typename Result,
+        template <typename Work, typename Result, typename Connection, typename Future,
+            typename std::enable_if<is_same<Result, future_result_t<Future>>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work(when_every_container<Result>&)>::value, int>::type = 0>
-        void when_every(Work&& w, when_every_worker<Result> p, std::future<Result> f) NOEXCEPT
+        void when_every(Work&& w, when_every_worker<Result, Connection> p, Future&& f) NOEXCEPT
         {
             dispatch_future(
-                [w, p](std::future<Result>&& f) mutable {
+                [w, p](typename std::decay<Future>::type&& f) mutable {
                     return p.work(w, f);
                 },
             std::move(f));
         }
 
-        template <typename Work, typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0,
-            typename std::enable_if<is_callable<Work(when_every_container<Result>&)>::value, int>::type = 0>
-        auto when_every(connection& c, Work&& w, std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT -> when_every_future<Result>
+        template <typename Connection, typename Work, typename Future, typename... Futures,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(when_every_container<future_result_t<Future>>&)>::value, int>::type = 0>
+        auto when_every(Connection& c, Work&& w, Future&& f, Futures&&... fs) NOEXCEPT -> when_every_future<future_result_t<Future>>
         {
-            when_every_worker<Result> p(sizeof...(Results)+1, c);
+            typedef future_result_t<Future> Result;
+            when_every_worker<Result, Connection> p(sizeof...(Futures)+1, c);
             when_every(std::forward<Work>(w), p, std::move(f), std::move(fs)...);
             return p.get_future();
         }
 
 
-        template <typename Result, typename... Results,
-            typename std::enable_if<is_same<Result, Results...>::value, int>::type = 0>
-        auto when_every(std::future<Result>&& f, std::future<Results>&&... fs) NOEXCEPT -> when_every_future<Result>
+        template <typename Future, typename... Futures,
+            typename std::enable_if<is_same<future_result_t<Future>, future_result_t<Futures>...>::value, int>::type = 0>
+        auto when_every(Future&& f, Futures&&... fs) NOEXCEPT -> when_every_future<future_result_t<Future>>
         {
+            typedef future_result_t<Future> Result;
             return when_every([](const when_every_container<Result>&){}, std::move(f), std::move(fs)...);
         }
 
+        /**
+         * Call a function once with every result of a list of futures,
+         * in the order they are met, and get all the results.
+         * Unlike when_every the function is not called with a lock,
+         * so it can run in many threads at the same time.
+         * The results are moved, their type has to be default constructible.
+         * @param work function that accepts the index of the future and its result
+         * @param futures to wait for
+         * @param order of the results, the completion order or the order of the futures
+         * @result future for the results of the futures that did not fail
+         */
+        template <typename Work, typename Future,
+            typename std::enable_if<is_future<Future>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(size_t, future_result_t<Future>&)>::value, int>::type = 0>
+        auto when_each(Work&& w, std::vector<Future>&& fs,
+            when_each_order order = when_each_order::completion) NOEXCEPT -> when_every_future<future_result_t<Future>>
+        {
+            null_connection c;
+            return when_each(c, std::forward<Work>(w), std::move(fs), order);
+        }
+
+        template <typename Connection, typename Work, typename Future,
+            typename std::enable_if<is_connection<Connection>::value, int>::type = 0,
+            typename std::enable_if<is_future<Future>::value, int>::type = 0,
+            typename std::enable_if<is_callable<Work(size_t, future_result_t<Future>&)>::value, int>::type = 0>
+        auto when_each(Connection& c, Work&& w, std::vector<Future>&& fs,
+            when_each_order order = when_each_order::completion) NOEXCEPT -> when_every_future<future_result_t<Future>>
+        {
+            when_each_worker<future_result_t<Future>, Connection> p(fs.size(), c, order);
+            for(size_t i=0; i<fs.size(); ++i)
+            {
+                dispatch_future(
+                    [w, p, i](Future&& f) mutable {
+                        return p.work(w, f, i);
+                    },
+                std::move(fs[i]));
+            }
+            return p.get_future();
+        }
+
+        /**
+         * Process tasks until the queue is empty.
+         * Returns when only waiting tasks that are not ready are left.
+         * @return true if any task was processed
+         */
         bool process_all() NOEXCEPT;
-        bool process_one() NOEXCEPT;
+
+        /**
+         * Process the first task of the queue. The task is run
+         * outside of the dispatcher lock so that many threads
+         * can process the same dispatcher at the same time.
+         * @return false if there was no task or only waiting
+         * tasks that are still not ready
+         */
+        virtual bool process_one() NOEXCEPT;
+
+        /**
+         * Process tasks until a time point. A task is not started if
+         * the average time of the previous tasks would go past it.
+         * Returns when only waiting tasks that are not ready are left.
+         */
+        process_report process_until(const clock::time_point& end) NOEXCEPT;
+
+        /**
+         * Process tasks for an amount of time, like process_until
+         */
+        process_report process_for(const clock::duration& budget) NOEXCEPT;
+
+        /**
+         * Average time that the tasks took in process_for and process_until
+         */
+        clock::duration get_task_cost() const NOEXCEPT;
+
+        /**
+         * Awaitable that resumes a C++20 coroutine in a task of the dispatcher.
+         * If the connection is interrupted or the task is destroyed
+         * without running the co_await throws connection_interrupted.
+         * See eventually/coro.hpp.
+         */
+        class schedule_awaiter
+        {
+        private:
+            template<typename Handle>
+            class resume_task : public basic_task
+            {
+            private:
+                Handle _handle;
+                bool& _resumed;
+
+            public:
+                resume_task(Handle h, bool& resumed):
+                _handle(h), _resumed(resumed)
+                {
+                }
+
+                ~resume_task()
+                {
+                    if(_handle)
+                    {
+                        // the dispatcher was destroyed, let the coroutine unwind
+                        _handle.resume();
+                    }
+                }
+
+                static void* operator new(size_t size)
+                {
+                    return task_pool::allocate(size);
+                }
+
+                static void operator delete(void* p, size_t size) NOEXCEPT
+                {
+                    task_pool::deallocate(p, size);
+                }
+
+                bool operator()()
+                {
+                    Handle h = _handle;
+                    _handle = Handle();
+                    _resumed = true;
+                    h.resume();
+                    return true;
+                }
+            };
+
+            dispatcher& _dispatcher;
+            connection _connection;
+            bool _resumed;
+
+        public:
+            schedule_awaiter(dispatcher& d, const connection& c) NOEXCEPT:
+            _dispatcher(d), _connection(c), _resumed(false)
+            {
+            }
+
+            bool await_ready() const NOEXCEPT
+            {
+                return false;
+            }
+
+            template<typename Handle>
+            void await_suspend(Handle h)
+            {
+                _dispatcher.push_task(basic_task_ptr(new resume_task<Handle>(h, _resumed)));
+            }
+
+            void await_resume()
+            {
+                if(!_resumed)
+                {
+                    throw connection_interrupted();
+                }
+                _connection.interruption_point();
+            }
+        };
+
+        /**
+         * co_await the result to continue a coroutine in the dispatcher
+         */
+        schedule_awaiter schedule() NOEXCEPT
+        {
+            return schedule_awaiter(*this, connection(nullptr));
+        }
+
+        schedule_awaiter schedule(const connection& c) NOEXCEPT
+        {
+            return schedule_awaiter(*this, c);
+        }
 
     };
+
+    /**
+     * A task that is queued again every period
+     * until its connection is interrupted
+     */
+    template<typename Connection, typename Work, typename... Args>
+    class periodic_task : public basic_task
+    {
+    private:
+        dispatcher& _dispatcher;
+        Connection _connection;
+        dispatcher::clock::duration _period;
+        dispatcher::clock::time_point _time;
+        Work _work;
+        std::tuple<Args...> _args;
+        promise<void> _promise;
+
+    public:
+
+        template<typename W, typename... A>
+        periodic_task(dispatcher& d, Connection& c, const dispatcher::clock::duration& period,
+            const dispatcher::clock::time_point& time, W&& w, A&&... args):
+        _dispatcher(d), _connection(c), _period(period), _time(time),
+        _work(std::forward<W>(w)), _args(std::forward<A>(args)...)
+        {
+        }
+
+        periodic_task(periodic_task&& other):
+        _dispatcher(other._dispatcher), _connection(other._connection),
+        _period(other._period), _time(other._time),
+        _work(std::move(other._work)), _args(std::move(other._args)),
+        _promise(std::move(other._promise))
+        {
+        }
+
+        static void* operator new(size_t size)
+        {
+            return task_pool::allocate(size);
+        }
+
+        static void operator delete(void* p, size_t size) NOEXCEPT
+        {
+            task_pool::deallocate(p, size);
+        }
+
+        future<void> get_future()
+        {
+            return _promise.get_future();
+        }
+
+        bool interrupted() const NOEXCEPT
+        {
+            return _connection.interrupted();
+        }
+
+        bool operator()()
+        {
+            try
+            {
+                std::lock_guard<Connection> lock(_connection);
+                _connection.interruption_point();
+                eventually::apply(_work, _args);
+            }
+            catch(...)
+            {
+                _promise.set_exception(std::current_exception());
+                return true;
+            }
+            if(_connection.interrupted())
+            {
+                _promise.set_exception(std::make_exception_ptr(connection_interrupted()));
+                return true;
+            }
+            auto now = dispatcher::clock::now();
+            do
+            {
+                _time += _period;
+            }
+            while(_time <= now && _period > dispatcher::clock::duration::zero());
+            auto time = _time;
+            _dispatcher.push_timer(time, basic_task_ptr(new periodic_task(std::move(*this))));
+            return true;
+        }
+    };
+
 }
 
 
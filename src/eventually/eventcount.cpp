@@ -0,0 +1,140 @@
+
+#include <eventually/eventcount.hpp>
+#include <limits>
+
+#ifdef EVENTUALLY_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace eventually {
+
+#ifdef EVENTUALLY_FUTEX
+    namespace {
+
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+            "the futex needs a plain 32 bit word");
+
+        void futex_wait(std::atomic<uint32_t>* addr, uint32_t value, const timespec* timeout) NOEXCEPT
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+                FUTEX_WAIT_PRIVATE, value, timeout, nullptr, 0);
+        }
+
+        void futex_wake(std::atomic<uint32_t>* addr, int count) NOEXCEPT
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+                FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+        }
+    }
+#endif
+
+    eventcount::eventcount()
+    {
+        _epoch.store(0);
+        _waiters.store(0);
+    }
+
+    eventcount::key eventcount::prepare_wait() NOEXCEPT
+    {
+        _waiters.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return _epoch.load(std::memory_order_seq_cst);
+    }
+
+    void eventcount::cancel_wait() NOEXCEPT
+    {
+        _waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void eventcount::commit_wait(key k, const clock::time_point& until) NOEXCEPT
+    {
+#ifdef EVENTUALLY_FUTEX
+        while(_epoch.load(std::memory_order_seq_cst) == k)
+        {
+            if(until == clock::time_point::max())
+            {
+                futex_wait(&_epoch, k, nullptr);
+                continue;
+            }
+            auto now = clock::now();
+            if(now >= until)
+            {
+                break;
+            }
+            auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(until - now).count();
+            timespec timeout;
+            timeout.tv_sec = left / 1000000000;
+            timeout.tv_nsec = left % 1000000000;
+            futex_wait(&_epoch, k, &timeout);
+        }
+#else
+        {
+            std::unique_lock<std::mutex> lock_(_mutex);
+            while(_epoch.load(std::memory_order_seq_cst) == k)
+            {
+                if(until == clock::time_point::max())
+                {
+                    _condition.wait(lock_);
+                }
+                else if(_condition.wait_until(lock_, until) == std::cv_status::timeout)
+                {
+                    break;
+                }
+            }
+        }
+#endif
+        _waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void eventcount::wake(size_t count) NOEXCEPT
+    {
+        // the condition was changed before this fence,
+        // so a waiter that is not counted yet will see it
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(_waiters.load(std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+#ifdef EVENTUALLY_FUTEX
+        _epoch.fetch_add(1, std::memory_order_seq_cst);
+        int n = count > (size_t)std::numeric_limits<int>::max() ?
+            std::numeric_limits<int>::max() : (int)count;
+        futex_wake(&_epoch, n);
+#else
+        {
+            std::lock_guard<std::mutex> lock_(_mutex);
+            _epoch.fetch_add(1, std::memory_order_seq_cst);
+        }
+        if(count == 1)
+        {
+            _condition.notify_one();
+        }
+        else
+        {
+            _condition.notify_all();
+        }
+#endif
+    }
+
+    void eventcount::notify(size_t count) NOEXCEPT
+    {
+        if(count > 0)
+        {
+            wake(count);
+        }
+    }
+
+    void eventcount::notify_all() NOEXCEPT
+    {
+        wake(std::numeric_limits<size_t>::max());
+    }
+
+    size_t eventcount::get_waiters() const NOEXCEPT
+    {
+        return _waiters.load();
+    }
+
+}
@@ -0,0 +1,74 @@
+#ifndef _eventually_eventcount_hpp_
+#define _eventually_eventcount_hpp_
+
+#include <eventually/define.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#if defined(__linux__)
+#define EVENTUALLY_FUTEX 1
+#endif
+
+namespace eventually {
+
+    /**
+     * Lets threads sleep until a condition that they check without
+     * locks changes. A waiter announces itself with prepare_wait,
+     * checks the condition again and then calls commit_wait or cancel_wait.
+     * Notifiers change the condition first and then call notify,
+     * which is just a fence and a load when nobody waits.
+     * Uses a futex on linux and a condition variable elsewhere.
+     */
+    class eventcount
+    {
+    public:
+        typedef std::chrono::steady_clock clock;
+        typedef uint32_t key;
+
+    private:
+        std::atomic<uint32_t> _epoch;
+        std::atomic<uint32_t> _waiters;
+#ifndef EVENTUALLY_FUTEX
+        std::mutex _mutex;
+        std::condition_variable _condition;
+#endif
+
+        eventcount(const eventcount&);
+        eventcount& operator=(const eventcount&);
+
+        void wake(size_t count) NOEXCEPT;
+
+    public:
+        eventcount();
+
+        /**
+         * Announce that the thread is going to wait,
+         * the condition has to be checked again after this
+         */
+        key prepare_wait() NOEXCEPT;
+
+        /**
+         * The condition changed, stop waiting
+         */
+        void cancel_wait() NOEXCEPT;
+
+        /**
+         * Sleep until notified after prepare_wait or until a time point
+         */
+        void commit_wait(key k, const clock::time_point& until=clock::time_point::max()) NOEXCEPT;
+
+        /**
+         * Wake up to count waiting threads
+         */
+        void notify(size_t count=1) NOEXCEPT;
+        void notify_all() NOEXCEPT;
+
+        size_t get_waiters() const NOEXCEPT;
+    };
+
+}
+
+#endif
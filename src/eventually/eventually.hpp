@@ -4,6 +4,7 @@
 
 #include <eventually/dispatcher.hpp>
 #include <eventually/thread_dispatcher.hpp>
+#include <eventually/strand.hpp>
 
 #include <eventually/http_client.hpp>
 #include <eventually/http_request.hpp>
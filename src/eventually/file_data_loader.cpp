@@ -59,6 +59,7 @@ namespace eventually {
 
     bool file_data_loader_work(data& d, FILE* fh, size_t block_size)
     {
+        blocking_scope blocking;
         std::lock_guard<std::mutex> lock(work_mutex);
         uint8_t b;
         while(block_size!=0)
@@ -93,13 +94,13 @@ namespace eventually {
         return *_dispatcher;
     }
 
-    std::future<data> file_data_loader::load(const std::string& name)
+    future<data> file_data_loader::load(const std::string& name)
     {
         connection conn;
         return load(conn, name);
     }
 
-    std::future<data> file_data_loader::load(connection& c, const std::string& name)
+    future<data> file_data_loader::load(connection& c, const std::string& name)
     {
         if(!_dispatcher)
         {
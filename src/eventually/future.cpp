@@ -0,0 +1,208 @@
+
+#include <eventually/future.hpp>
+#include <eventually/task_pool.hpp>
+
+namespace eventually {
+
+    /**
+     * Wakes up the threads blocked on a completion. There is only one for
+     * every completion and it is shared with its continuation, because the
+     * completion can be destroyed by a woken up thread before the
+     * continuation returns.
+     */
+    struct future_completion::waiter
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool done;
+        std::atomic<int> references;
+
+        waiter():
+        done(false)
+        {
+            references.store(2, std::memory_order_relaxed);
+        }
+
+        static void* operator new(size_t size)
+        {
+            return task_pool::allocate(size);
+        }
+
+        static void operator delete(void* p, size_t size) NOEXCEPT
+        {
+            task_pool::deallocate(p, size);
+        }
+
+        void notify()
+        {
+            std::lock_guard<std::mutex> lock_(mutex);
+            done = true;
+            condition.notify_all();
+        }
+
+        void release() NOEXCEPT
+        {
+            if(references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                delete this;
+            }
+        }
+    };
+
+    future_completion::future_completion():
+    _head(nullptr), _waiter(nullptr)
+    {
+    }
+
+    future_completion::~future_completion()
+    {
+        node* n = _head.load(std::memory_order_relaxed);
+        while(n != nullptr && n != done_node())
+        {
+            node* next = n->next;
+            delete n;
+            n = next;
+        }
+        waiter* w = _waiter.load(std::memory_order_acquire);
+        if(w != nullptr)
+        {
+            w->release();
+        }
+    }
+
+    void future_completion::push(node* n) NOEXCEPT
+    {
+        node* head = _head.load(std::memory_order_acquire);
+        do
+        {
+            if(head == done_node())
+            {
+                n->run();
+                delete n;
+                return;
+            }
+            n->next = head;
+        }
+        while(!_head.compare_exchange_weak(head, n,
+            std::memory_order_acq_rel, std::memory_order_acquire));
+    }
+
+    void future_completion::done() NOEXCEPT
+    {
+        node* n = _head.exchange(done_node(), std::memory_order_acq_rel);
+        if(n == done_node())
+        {
+            return;
+        }
+        // the stack has the last continuation first
+        node* ordered = nullptr;
+        while(n != nullptr)
+        {
+            node* next = n->next;
+            n->next = ordered;
+            ordered = n;
+            n = next;
+        }
+        // this can be destroyed by the last continuation
+        while(ordered != nullptr)
+        {
+            node* next = ordered->next;
+            ordered->run();
+            delete ordered;
+            ordered = next;
+        }
+    }
+
+    bool future_completion::is_done() const NOEXCEPT
+    {
+        return _head.load(std::memory_order_acquire) == done_node();
+    }
+
+    future_completion::waiter& future_completion::get_waiter()
+    {
+        waiter* w = _waiter.load(std::memory_order_acquire);
+        if(w != nullptr)
+        {
+            return *w;
+        }
+        // one reference for the completion and one for the continuation
+        waiter* created = new waiter();
+        if(!_waiter.compare_exchange_strong(w, created,
+            std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            delete created;
+            return *w;
+        }
+        then([created](){
+            created->notify();
+            created->release();
+        });
+        return *created;
+    }
+
+    void future_completion::wait()
+    {
+        if(is_done())
+        {
+            return;
+        }
+        waiter& w = get_waiter();
+        std::unique_lock<std::mutex> lock_(w.mutex);
+        while(!w.done)
+        {
+            w.condition.wait(lock_);
+        }
+    }
+
+    bool future_completion::wait_until(const std::chrono::steady_clock::time_point& time)
+    {
+        if(is_done())
+        {
+            return true;
+        }
+        // the waiter is reused, so timed waits in a loop do not add continuations
+        waiter& w = get_waiter();
+        std::unique_lock<std::mutex> lock_(w.mutex);
+        while(!w.done)
+        {
+            if(w.condition.wait_until(lock_, time) == std::cv_status::timeout)
+            {
+                return w.done;
+            }
+        }
+        return true;
+    }
+
+    future_completion_guard::future_completion_guard()
+    {
+    }
+
+    future_completion_guard::future_completion_guard(future_completion_guard&& other) NOEXCEPT:
+    _completion(std::move(other._completion))
+    {
+    }
+
+    future_completion_guard::~future_completion_guard()
+    {
+        done();
+    }
+
+    const future_completion_ptr& future_completion_guard::get()
+    {
+        if(!_completion)
+        {
+            _completion = std::allocate_shared<future_completion>(
+                task_pool_allocator<future_completion>());
+        }
+        return _completion;
+    }
+
+    void future_completion_guard::done() NOEXCEPT
+    {
+        if(_completion)
+        {
+            _completion->done();
+        }
+    }
+
+}
@@ -0,0 +1,797 @@
+#ifndef _eventually_future_hpp_
+#define _eventually_future_hpp_
+
+#include <eventually/define.hpp>
+#include <eventually/connection.hpp>
+#include <eventually/is_callable.hpp>
+#include <eventually/task_pool.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eventually {
+
+    /**
+     * A list of functions to be called once when a promise is fulfilled.
+     * Functions added after that are called right away.
+     * The list is a lock free stack, so adding a continuation is a
+     * compare and swap and checking if it is done is a load.
+     */
+    class future_completion
+    {
+    public:
+        typedef std::function<void()> continuation;
+
+    private:
+        struct node
+        {
+            node* next;
+
+            node():
+            next(nullptr)
+            {
+            }
+
+            virtual ~node()
+            {
+            }
+
+            virtual void run() = 0;
+        };
+
+        template<typename Continuation>
+        struct continuation_node : public node
+        {
+            Continuation continuation_;
+
+            template<typename C>
+            continuation_node(C&& c):
+            continuation_(std::forward<C>(c))
+            {
+            }
+
+            static void* operator new(size_t size)
+            {
+                return task_pool::allocate(size);
+            }
+
+            static void operator delete(void* p, size_t size) NOEXCEPT
+            {
+                task_pool::deallocate(p, size);
+            }
+
+            void run()
+            {
+                continuation_();
+            }
+        };
+
+        struct waiter;
+
+        std::atomic<node*> _head;
+        std::atomic<waiter*> _waiter;
+
+        future_completion(const future_completion&);
+        future_completion& operator=(const future_completion&);
+
+        /**
+         * Marks the list as done, nodes are aligned so it is never a valid one
+         */
+        static node* done_node() NOEXCEPT
+        {
+            return reinterpret_cast<node*>(uintptr_t(1));
+        }
+
+        void push(node* n) NOEXCEPT;
+
+        /**
+         * Get the waiter of the blocking waits, the first call creates it
+         * and adds the continuation that wakes them up
+         */
+        waiter& get_waiter();
+
+    public:
+        future_completion();
+        ~future_completion();
+
+        /**
+         * Call a function when the promise is fulfilled,
+         * in the thread that fulfills it
+         */
+        template<typename Continuation>
+        void then(Continuation&& c)
+        {
+            push(new continuation_node<typename std::decay<Continuation>::type>(
+                std::forward<Continuation>(c)));
+        }
+
+        /**
+         * Call all the continuations, only the first call does something
+         */
+        void done() NOEXCEPT;
+
+        bool is_done() const NOEXCEPT;
+
+        /**
+         * Block until done is called
+         */
+        void wait();
+
+        /**
+         * Block until done is called or a time point is reached
+         * @return true if it is done
+         */
+        bool wait_until(const std::chrono::steady_clock::time_point& time);
+    };
+
+    typedef std::shared_ptr<future_completion> future_completion_ptr;
+
+    /**
+     * Owns a completion and calls done when destroyed,
+     * for results that are not stored in an eventually::promise.
+     * Should be declared before the promise it belongs to so that
+     * a broken promise is already set when the continuations are called.
+     */
+    class future_completion_guard
+    {
+    private:
+        future_completion_ptr _completion;
+
+        future_completion_guard(const future_completion_guard&);
+        future_completion_guard& operator=(const future_completion_guard&);
+
+    public:
+        future_completion_guard();
+        future_completion_guard(future_completion_guard&& other) NOEXCEPT;
+        ~future_completion_guard();
+
+        /**
+         * Get the completion creating it if needed
+         */
+        const future_completion_ptr& get();
+        void done() NOEXCEPT;
+    };
+
+    /**
+     * The state shared by a promise and its future. The result is stored
+     * inline and the whole state comes from the task pool. It is its own
+     * completion, so it is done once the result or the exception is set.
+     */
+    class future_state_base : public future_completion
+    {
+    private:
+        std::exception_ptr _exception;
+        weak_connection _connection;
+
+    protected:
+        bool _retrieved;
+
+        void rethrow()
+        {
+            if(_exception)
+            {
+                std::rethrow_exception(_exception);
+            }
+        }
+
+    public:
+        future_state_base():
+        _retrieved(false)
+        {
+        }
+
+        /**
+         * The connection of the work that fulfills the state,
+         * it is only set before the future is retrieved
+         */
+        void set_connection(const weak_connection& c) NOEXCEPT
+        {
+            _connection = c;
+        }
+
+        const weak_connection& get_connection() const NOEXCEPT
+        {
+            return _connection;
+        }
+
+        void set_exception(std::exception_ptr e) NOEXCEPT
+        {
+            _exception = e;
+            done();
+        }
+
+        /**
+         * Only one future can be created for a state
+         */
+        void retrieve()
+        {
+            if(_retrieved)
+            {
+                throw std::future_error(std::future_errc::future_already_retrieved);
+            }
+            _retrieved = true;
+        }
+    };
+
+    template<typename Result>
+    class future_state : public future_state_base
+    {
+    private:
+        typename std::aligned_storage<sizeof(Result), std::alignment_of<Result>::value>::type _storage;
+        bool _has_value;
+
+    public:
+        future_state():
+        _has_value(false)
+        {
+        }
+
+        ~future_state()
+        {
+            if(_has_value)
+            {
+                reinterpret_cast<Result*>(&_storage)->~Result();
+            }
+        }
+
+        template<typename Value>
+        void set_value(Value&& v)
+        {
+            new (&_storage) Result(std::forward<Value>(v));
+            _has_value = true;
+            done();
+        }
+
+        Result get()
+        {
+            wait();
+            rethrow();
+            return std::move(*reinterpret_cast<Result*>(&_storage));
+        }
+    };
+
+    template<>
+    class future_state<void> : public future_state_base
+    {
+    public:
+        void set_value() NOEXCEPT
+        {
+            done();
+        }
+
+        void get()
+        {
+            wait();
+            rethrow();
+        }
+    };
+
+    template<typename Result>
+    class promise;
+
+    /**
+     * The future of an eventually::promise, for example the ones returned
+     * by the dispatchers. It works like a std::future, but a
+     * continuation can be added with then and is_ready does not lock,
+     * so the dispatcher queues the tasks that wait for it
+     * instead of checking if it is ready.
+     * It can be constructed from a std::future and converted to one,
+     * in that case it has no completion.
+     */
+    template<typename Result>
+    class future
+    {
+    public:
+        typedef future_state<Result> state;
+
+    private:
+        std::shared_ptr<state> _state;
+        std::future<Result> _future;
+
+        future(const future&);
+        future& operator=(const future&);
+
+        /**
+         * Moves the result of the state to a std::promise
+         */
+        struct std_continuation
+        {
+            std::shared_ptr<state> state_;
+            std::promise<Result> promise_;
+
+            template<typename R=Result,
+                typename std::enable_if<!std::is_void<R>::value, int>::type = 0>
+            void set()
+            {
+                promise_.set_value(state_->get());
+            }
+
+            template<typename R=Result,
+                typename std::enable_if<std::is_void<R>::value, int>::type = 0>
+            void set()
+            {
+                state_->get();
+                promise_.set_value();
+            }
+
+            void operator()()
+            {
+                try
+                {
+                    set();
+                }
+                catch(...)
+                {
+                    promise_.set_exception(std::current_exception());
+                }
+            }
+        };
+
+        template<typename Work, typename Next>
+        struct then_continuation
+        {
+            std::shared_ptr<state> state_;
+            promise<Next> promise_;
+            Work work_;
+
+            template<typename R=Result, typename N=Next,
+                typename std::enable_if<!std::is_void<R>::value && !std::is_void<N>::value, int>::type = 0>
+            void set()
+            {
+                promise_.set_value(work_(state_->get()));
+            }
+
+            template<typename R=Result, typename N=Next,
+                typename std::enable_if<!std::is_void<R>::value && std::is_void<N>::value, int>::type = 0>
+            void set()
+            {
+                work_(state_->get());
+                promise_.set_value();
+            }
+
+            template<typename R=Result, typename N=Next,
+                typename std::enable_if<std::is_void<R>::value && !std::is_void<N>::value, int>::type = 0>
+            void set()
+            {
+                state_->get();
+                promise_.set_value(work_());
+            }
+
+            template<typename R=Result, typename N=Next,
+                typename std::enable_if<std::is_void<R>::value && std::is_void<N>::value, int>::type = 0>
+            void set()
+            {
+                state_->get();
+                work_();
+                promise_.set_value();
+            }
+
+            void operator()()
+            {
+                try
+                {
+                    set();
+                }
+                catch(...)
+                {
+                    promise_.set_exception(std::current_exception());
+                }
+            }
+        };
+
+        template<typename R=Result,
+            typename std::enable_if<!std::is_void<R>::value, int>::type = 0>
+        static void adopt_result(promise<R>& p, std::future<R>& f)
+        {
+            p.set_value(f.get());
+        }
+
+        template<typename R=Result,
+            typename std::enable_if<std::is_void<R>::value, int>::type = 0>
+        static void adopt_result(promise<R>& p, std::future<R>& f)
+        {
+            f.get();
+            p.set_value();
+        }
+
+        /**
+         * Move the result of the std::future to a state
+         */
+        void adopt()
+        {
+            promise<Result> p;
+            _state = p.get_future()._state;
+            try
+            {
+                adopt_result(p, _future);
+            }
+            catch(...)
+            {
+                p.set_exception(std::current_exception());
+            }
+            _future = std::future<Result>();
+        }
+
+        template<typename Work, typename R=Result>
+        struct then_result
+        {
+            typedef typename result_of<Work(R)>::type type;
+        };
+
+        template<typename Work>
+        struct then_result<Work, void>
+        {
+            typedef typename result_of<Work()>::type type;
+        };
+
+    public:
+        future() NOEXCEPT
+        {
+        }
+
+        explicit future(const std::shared_ptr<state>& s) NOEXCEPT:
+        _state(s)
+        {
+        }
+
+        future(std::future<Result>&& f) NOEXCEPT:
+        _future(std::move(f))
+        {
+        }
+
+        future(future&& other) NOEXCEPT:
+        _state(std::move(other._state)), _future(std::move(other._future))
+        {
+        }
+
+        future& operator=(future&& other) NOEXCEPT
+        {
+            _state = std::move(other._state);
+            _future = std::move(other._future);
+            return *this;
+        }
+
+        bool valid() const NOEXCEPT
+        {
+            return _state || _future.valid();
+        }
+
+        /**
+         * True if get will not block
+         */
+        bool is_ready() const NOEXCEPT
+        {
+            if(_state)
+            {
+                return _state->is_done();
+            }
+            return _future.valid() &&
+                _future.wait_for(std::chrono::seconds::zero()) == std::future_status::ready;
+        }
+
+        /**
+         * The connection of the work that fulfills this future,
+         * a null connection if it has none
+         */
+        weak_connection get_connection() const NOEXCEPT
+        {
+            if(!_state)
+            {
+                return weak_connection();
+            }
+            return _state->get_connection();
+        }
+
+        /**
+         * Interrupt the work that fulfills this future,
+         * the future is still valid and will throw connection_interrupted
+         * if the work had not started
+         */
+        void interrupt() NOEXCEPT
+        {
+            if(_state)
+            {
+                get_connection().interrupt();
+            }
+        }
+
+        Result get()
+        {
+            if(!_state)
+            {
+                return _future.get();
+            }
+            std::shared_ptr<state> s(std::move(_state));
+            return s->get();
+        }
+
+        void wait() const
+        {
+            if(_state)
+            {
+                _state->wait();
+            }
+            else
+            {
+                _future.wait();
+            }
+        }
+
+        template<typename Clock, typename Duration>
+        std::future_status wait_until(const std::chrono::time_point<Clock, Duration>& time) const
+        {
+            if(!_state)
+            {
+                return _future.wait_until(time);
+            }
+            return wait_for(time - Clock::now());
+        }
+
+        template<typename Rep, typename Period>
+        std::future_status wait_for(const std::chrono::duration<Rep, Period>& duration) const
+        {
+            if(!_state)
+            {
+                return _future.wait_for(duration);
+            }
+            if(_state->is_done())
+            {
+                return std::future_status::ready;
+            }
+            if(duration <= duration.zero())
+            {
+                return std::future_status::timeout;
+            }
+            auto time = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(duration);
+            return _state->wait_until(time) ? std::future_status::ready : std::future_status::timeout;
+        }
+
+        /**
+         * The completion of the promise,
+         * null if it was constructed from a std::future
+         */
+        future_completion_ptr get_completion() const NOEXCEPT
+        {
+            return _state;
+        }
+
+        /**
+         * Call a function with the result when the promise is fulfilled, in the thread
+         * that fulfills it. Exceptions are passed to the returned future
+         * without calling the function. This future is no longer valid.
+         */
+        template<typename Work>
+        auto then(Work&& w) -> future<typename then_result<typename std::decay<Work>::type>::type>
+        {
+            typedef typename std::decay<Work>::type work;
+            typedef typename then_result<work>::type next;
+            if(!_state)
+            {
+                // a std::future has no completion, wait for it here
+                adopt();
+            }
+            promise<next> p;
+            p.set_connection(_state->get_connection());
+            auto f = p.get_future();
+            std::shared_ptr<state> s(std::move(_state));
+            s->then(then_continuation<work, next>{s, std::move(p), std::forward<Work>(w)});
+            return f;
+        }
+
+        /**
+         * A std::future that gets the result when the promise is fulfilled
+         */
+        operator std::future<Result>() &&
+        {
+            if(!_state)
+            {
+                return std::move(_future);
+            }
+            std::promise<Result> p;
+            auto f = p.get_future();
+            std::shared_ptr<state> s(std::move(_state));
+            s->then(std_continuation{s, std::move(p)});
+            return f;
+        }
+    };
+
+    template<typename Result>
+    class promise_base
+    {
+    protected:
+        typedef future_state<Result> state;
+
+        std::shared_ptr<state> _state;
+        bool _satisfied;
+
+        void satisfy()
+        {
+            if(!_state)
+            {
+                throw std::future_error(std::future_errc::no_state);
+            }
+            if(_satisfied)
+            {
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+            }
+            _satisfied = true;
+        }
+
+    private:
+        promise_base(const promise_base&);
+        promise_base& operator=(const promise_base&);
+
+        void abandon() NOEXCEPT
+        {
+            if(_state && !_satisfied)
+            {
+                _state->set_exception(std::make_exception_ptr(
+                    std::future_error(std::future_errc::broken_promise)));
+            }
+        }
+
+    public:
+        promise_base():
+        _state(std::allocate_shared<state>(task_pool_allocator<state>())),
+        _satisfied(false)
+        {
+        }
+
+        promise_base(promise_base&& other) NOEXCEPT:
+        _state(std::move(other._state)), _satisfied(other._satisfied)
+        {
+        }
+
+        promise_base& operator=(promise_base&& other) NOEXCEPT
+        {
+            abandon();
+            _state = std::move(other._state);
+            _satisfied = other._satisfied;
+            return *this;
+        }
+
+        ~promise_base()
+        {
+            abandon();
+        }
+
+        future<Result> get_future()
+        {
+            if(!_state)
+            {
+                throw std::future_error(std::future_errc::no_state);
+            }
+            _state->retrieve();
+            return future<Result>(_state);
+        }
+
+        void set_exception(std::exception_ptr e)
+        {
+            satisfy();
+            _state->set_exception(e);
+        }
+
+        /**
+         * Set the connection of the work that will fulfill the promise,
+         * so that the future can interrupt it. Call it before get_future.
+         */
+        void set_connection(const weak_connection& c)
+        {
+            if(!_state)
+            {
+                throw std::future_error(std::future_errc::no_state);
+            }
+            _state->set_connection(c);
+        }
+
+        void set_connection(const null_connection&) NOEXCEPT
+        {
+        }
+    };
+
+    /**
+     * Stores a result for an eventually::future,
+     * fulfilling it calls the continuations of the future.
+     * If it is destroyed before that the future throws
+     * std::future_error with std::future_errc::broken_promise
+     */
+    template<typename Result>
+    class promise : public promise_base<Result>
+    {
+    public:
+        template<typename Value>
+        void set_value(Value&& v)
+        {
+            this->satisfy();
+            this->_state->set_value(std::forward<Value>(v));
+        }
+    };
+
+    template<>
+    class promise<void> : public promise_base<void>
+    {
+    public:
+        void set_value()
+        {
+            satisfy();
+            _state->set_value();
+        }
+    };
+
+    template<typename Result>
+    future_completion_ptr get_future_completion(const std::future<Result>& f) NOEXCEPT
+    {
+        return nullptr;
+    }
+
+    template<typename Result>
+    future_completion_ptr get_future_completion(const future<Result>& f) NOEXCEPT
+    {
+        return f.get_completion();
+    }
+
+    template<typename Result>
+    weak_connection get_future_connection(const std::future<Result>& f) NOEXCEPT
+    {
+        return weak_connection();
+    }
+
+    template<typename Result>
+    weak_connection get_future_connection(const future<Result>& f) NOEXCEPT
+    {
+        return f.get_connection();
+    }
+
+    /**
+     * The result type of a future passed as an rvalue,
+     * empty for anything else.
+     */
+    template<typename Future>
+    struct future_result
+    {
+    };
+
+    template<typename Result>
+    struct future_result<std::future<Result>>
+    {
+        typedef Result type;
+    };
+
+    template<typename Result>
+    struct future_result<future<Result>>
+    {
+        typedef Result type;
+    };
+
+    template<typename Future>
+    using future_result_t = typename future_result<Future>::type;
+
+    /**
+     * True if all the types are futures
+     */
+    template<typename... Futures>
+    struct is_future : std::true_type {};
+
+    template<typename Future, typename... Futures>
+    struct is_future<Future, Futures...> : std::false_type {};
+
+    template<typename Result, typename... Futures>
+    struct is_future<std::future<Result>, Futures...> : is_future<Futures...> {};
+
+    template<typename Result, typename... Futures>
+    struct is_future<future<Result>, Futures...> : is_future<Futures...> {};
+
+}
+
+#endif
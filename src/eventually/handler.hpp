@@ -26,15 +26,17 @@ namespace eventually {
         {
         }
 
-        template <typename Work, typename Result,
+        /**
+         * Runs the work with the connection locked. The result is set after
+         * unlocking it, so the continuations of the promise do not run locked.
+         */
+        template <typename Work, typename Connection, template<typename> class Promise, typename Result,
             typename std::enable_if<is_callable_with_result<Work(Args&&...), Result>::value, int>::type = 0>
-        void operator()(Work&& w, connection& c, std::promise<Result>& p) const NOEXCEPT
+        void operator()(Work&& w, Connection& c, Promise<Result>& p) const NOEXCEPT
         {
-            std::lock_guard<std::mutex> lock(c.get_mutex());
             try
             {
-                c.interruption_point();
-                p.set_value(apply(w, std::move(_args)));
+                p.set_value(run(w, c));
             }
             catch(...)
             {
@@ -42,30 +44,35 @@ namespace eventually {
             }
         }
 
-        template <typename Work,
+        template <typename Work, typename Connection, template<typename> class Promise,
             typename std::enable_if<is_callable_with_result<Work(Args&&...), void>::value, int>::type = 0>
-        void operator()(Work&& w, connection& c, std::promise<void>& p) const NOEXCEPT
+        void operator()(Work&& w, Connection& c, Promise<void>& p) const NOEXCEPT
         {
-            std::lock_guard<std::mutex> lock(c.get_mutex());
             try
             {
-                c.interruption_point();
-                apply(w, std::move(_args));
+                run(w, c);
                 p.set_value();
             }
             catch(...)
             {
                 p.set_exception(std::current_exception());
-            }                
+            }
         }
 
+        template <typename Work, typename Connection>
+        auto run(Work& w, Connection& c) const -> typename result_of<Work(Args&&...)>::type
+        {
+            std::lock_guard<Connection> lock(c);
+            c.interruption_point();
+            return eventually::apply(w, std::move(_args));
+        }
 
-        template <typename Retry,
+        template <typename Retry, typename Connection,
             typename std::enable_if<is_callable_with_result<Retry(Args&...), bool>::value, int>::type = 0>
-        bool operator()(Retry&& r, connection& c) const NOEXCEPT
+        bool operator()(Retry&& r, Connection& c) const NOEXCEPT
         {
-            std::lock_guard<std::mutex> lock(c.get_mutex());
-            return apply(r, _args);
+            std::lock_guard<Connection> lock(c);
+            return eventually::apply(r, _args);
         }
 
     };
@@ -5,6 +5,7 @@
 #include <eventually/dispatcher.hpp>
 #include <eventually/connection.hpp>
 #include <eventually/thread_dispatcher.hpp>
+#include <eventually/tracer.hpp>
 #include <functional>
 #include <curl/curl.h>
 
@@ -127,9 +128,14 @@ namespace eventually {
         http_response resp;
     };
 
+    // returning a different size or a non zero progress makes curl abort,
+    // exceptions can not be thrown through it
     size_t write_data(void* ptr, size_t size, size_t nmemb, http_client_data* data)
     {
-        data->conn.interruption_point();
+        if(data->conn.interrupted())
+        {
+            return 0;
+        }
         size_t n = (size * nmemb);
         http_response::data& rbody = data->resp.get_body();
         auto rptr = (http_response::data::value_type*)ptr;
@@ -139,19 +145,27 @@ namespace eventually {
 
     size_t write_header(char* buffer, size_t size, size_t nitems, http_client_data* data)
     {
-        data->conn.interruption_point();
+        if(data->conn.interrupted())
+        {
+            return 0;
+        }
         size_t n = (size * nitems);
         data->resp.add_header_str(std::string(buffer, n));
         return n;
     }
 
+    int transfer_progress(http_client_data* data, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+    {
+        return data->conn.interrupted() ? 1 : 0;
+    }
+
     http_response http_client::send_dispatched(connection& c, const http_request& req)
     {
         curl_object curl;
         curl.init();
         curl.set_opt(CURLOPT_URL, req.get_url());
         curl.set_opt(CURLOPT_FOLLOWLOCATION, true);
-        curl.set_opt(CURLOPT_NOPROGRESS, true);
+        curl.set_opt(CURLOPT_NOPROGRESS, false);
         curl.set_headers(req.get_headers());
 
         switch(req.get_method())
@@ -174,8 +188,21 @@ namespace eventually {
         curl.set_opt(CURLOPT_WRITEDATA, &data);
         curl.set_opt(CURLOPT_HEADERFUNCTION, write_header);
         curl.set_opt(CURLOPT_HEADERDATA, &data);
+        // called while waiting too, so an interrupted request closes its socket
+        curl.set_opt(CURLOPT_XFERINFOFUNCTION, transfer_progress);
+        curl.set_opt(CURLOPT_XFERINFODATA, &data);
 
-        curl.perform();
+        try
+        {
+            // curl waits for the network in this thread
+            blocking_scope blocking;
+            curl.perform();
+        }
+        catch(...)
+        {
+            c.interruption_point();
+            throw;
+        }
         long http_code = 0;
         curl.get_info(CURLINFO_RESPONSE_CODE, &http_code);
         data.resp.set_code(http_code);
@@ -183,19 +210,21 @@ namespace eventually {
         return data.resp;
     }
 
-    std::future<http_response> http_client::send(const http_request& req)
+    future<http_response> http_client::send(const http_request& req)
     {
-        connection conn;
+        connection conn(nullptr);
         return send(conn, req);
     }
 
-    std::future<http_response> http_client::send(connection& c, const http_request& req)
+    future<http_response> http_client::send(connection& c, const http_request& req)
     {
         if(!_dispatcher)
         {
             throw new http_exception("No dispatcher found.");
         }
-        return _dispatcher->dispatch(std::bind(&http_client::send_dispatched, this, c, req));
+        trace_label label("http_client::send");
+        // a request that is interrupted before it starts is not sent
+        return _dispatcher->dispatch(c, std::bind(&http_client::send_dispatched, this, c, req));
     }
 
     dispatcher& http_client::get_dispatcher()
@@ -1,7 +1,7 @@
 #ifndef _eventually_http_client_hpp_
 #define _eventually_http_client_hpp_
 
-#include <future>
+#include <eventually/future.hpp>
 #include <exception>
 #include <string>
 
@@ -40,8 +40,8 @@ namespace eventually{
         ~http_client();
 
         dispatcher& get_dispatcher();
-        std::future<http_response> send(const http_request& req);
-        std::future<http_response> send(connection& c, const http_request& req);
+        future<http_response> send(const http_request& req);
+        future<http_response> send(connection& c, const http_request& req);
     };
 
 }
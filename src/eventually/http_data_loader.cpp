@@ -69,13 +69,13 @@ namespace eventually {
         }
     }
 
-    std::future<data> http_data_loader::load(const std::string& name)
+    future<data> http_data_loader::load(const std::string& name)
     {
         connection conn;
         return load(conn, name);
     }
 
-    std::future<data> http_data_loader::load(connection& c, const std::string& name)
+    future<data> http_data_loader::load(connection& c, const std::string& name)
     {
         if(!_client)
         {
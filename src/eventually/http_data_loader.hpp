@@ -34,8 +34,8 @@ namespace eventually {
         void set_request_create(const request_create& create);
         dispatcher& get_dispatcher();
         http_client& get_client();
-        std::future<data> load(connection& c, const std::string& name);
-        std::future<data> load(const std::string& name);
+        future<data> load(connection& c, const std::string& name);
+        future<data> load(const std::string& name);
     };
 }
 
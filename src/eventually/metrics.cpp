@@ -0,0 +1,163 @@
+
+#include <eventually/metrics.hpp>
+#include <algorithm>
+
+namespace eventually {
+
+    namespace {
+
+        size_t highest_bit(uint64_t v) NOEXCEPT
+        {
+#if defined(__GNUC__)
+            return 63 - __builtin_clzll(v);
+#else
+            size_t n = 0;
+            while(v >>= 1)
+            {
+                ++n;
+            }
+            return n;
+#endif
+        }
+
+        uint64_t to_nanoseconds(const metrics_recorder::clock::duration& d) NOEXCEPT
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+            return ns > 0 ? ns : 0;
+        }
+    }
+
+    histogram_snapshot::histogram_snapshot():
+    count(0), sum(0), max(0)
+    {
+    }
+
+    uint64_t histogram_snapshot::get_percentile(double p) const NOEXCEPT
+    {
+        if(count == 0)
+        {
+            return 0;
+        }
+        uint64_t target = std::max<uint64_t>(1, (uint64_t)(p * count + 0.5));
+        uint64_t total = 0;
+        for(size_t i=0; i<counts.size(); ++i)
+        {
+            total += counts[i];
+            if(total >= target)
+            {
+                // the highest value of the bucket
+                uint64_t value = i + 1 < histogram::bucket_count ?
+                    histogram::get_bucket_value(i + 1) - 1 : max;
+                return std::min(value, max);
+            }
+        }
+        return max;
+    }
+
+    double histogram_snapshot::get_mean() const NOEXCEPT
+    {
+        return count == 0 ? 0.0 : (double)sum / count;
+    }
+
+    histogram::histogram()
+    {
+        for(size_t i=0; i<bucket_count; ++i)
+        {
+            _counts[i].store(0, std::memory_order_relaxed);
+        }
+        _sum.store(0);
+        _max.store(0);
+    }
+
+    size_t histogram::get_bucket(uint64_t value) NOEXCEPT
+    {
+        if(value < sub_bucket_count)
+        {
+            return value;
+        }
+        size_t bit = highest_bit(value);
+        if(bit >= max_value_bits)
+        {
+            return bucket_count - 1;
+        }
+        // the bits after the highest one select the sub bucket
+        size_t shift = bit - sub_bucket_bits;
+        return (bit - sub_bucket_bits + 1) * sub_bucket_count + ((value >> shift) & (sub_bucket_count - 1));
+    }
+
+    uint64_t histogram::get_bucket_value(size_t bucket) NOEXCEPT
+    {
+        if(bucket < sub_bucket_count)
+        {
+            return bucket;
+        }
+        size_t shift = bucket / sub_bucket_count - 1;
+        return (uint64_t)(sub_bucket_count + bucket % sub_bucket_count) << shift;
+    }
+
+    void histogram::record(uint64_t value) NOEXCEPT
+    {
+        _counts[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = _max.load(std::memory_order_relaxed);
+        while(value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    histogram_snapshot histogram::get_snapshot() const
+    {
+        histogram_snapshot s;
+        s.counts.resize(bucket_count);
+        for(size_t i=0; i<bucket_count; ++i)
+        {
+            s.counts[i] = _counts[i].load(std::memory_order_relaxed);
+            s.count += s.counts[i];
+        }
+        s.sum = _sum.load(std::memory_order_relaxed);
+        s.max = _max.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    dispatcher_metrics::dispatcher_metrics():
+    pushed(0), popped(0), not_ready(0),
+    queue_size(0), waiting_size(0)
+    {
+    }
+
+    metrics_recorder::metrics_recorder()
+    {
+        _pushed.store(0);
+        _popped.store(0);
+        _not_ready.store(0);
+    }
+
+    void metrics_recorder::record_push(size_t count) NOEXCEPT
+    {
+        _pushed.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void metrics_recorder::record_process(const clock::duration& wait, const clock::duration& run, bool ready) NOEXCEPT
+    {
+        _popped.fetch_add(1, std::memory_order_relaxed);
+        if(ready)
+        {
+            _wait_time.record(to_nanoseconds(wait));
+            _run_time.record(to_nanoseconds(run));
+        }
+        else
+        {
+            _not_ready.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void metrics_recorder::get_metrics(dispatcher_metrics& m) const
+    {
+        m.pushed = _pushed.load(std::memory_order_relaxed);
+        m.popped = _popped.load(std::memory_order_relaxed);
+        m.not_ready = _not_ready.load(std::memory_order_relaxed);
+        m.wait_time = _wait_time.get_snapshot();
+        m.run_time = _run_time.get_snapshot();
+    }
+
+}
@@ -0,0 +1,129 @@
+#ifndef _eventually_metrics_hpp_
+#define _eventually_metrics_hpp_
+
+#include <eventually/define.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace eventually {
+
+    /**
+     * The values of a histogram at some point
+     */
+    struct histogram_snapshot
+    {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+        std::vector<uint64_t> counts;
+
+        histogram_snapshot();
+
+        /**
+         * Get the value under which a fraction of the values are
+         * @param p fraction between 0 and 1
+         */
+        uint64_t get_percentile(double p) const NOEXCEPT;
+        double get_mean() const NOEXCEPT;
+    };
+
+    /**
+     * A lock free histogram with logarithmic buckets like HdrHistogram.
+     * Every power of two is split in 16 buckets,
+     * so a value is stored with an error of at most 6.25%.
+     */
+    class histogram
+    {
+    public:
+        static const size_t sub_bucket_bits = 4;
+        static const size_t sub_bucket_count = 1 << sub_bucket_bits;
+        static const size_t max_value_bits = 48;
+        static const size_t bucket_count = (max_value_bits - sub_bucket_bits + 1) * sub_bucket_count;
+
+    private:
+        std::atomic<uint64_t> _counts[bucket_count];
+        std::atomic<uint64_t> _sum;
+        std::atomic<uint64_t> _max;
+
+        histogram(const histogram&);
+        histogram& operator=(const histogram&);
+
+    public:
+        histogram();
+
+        void record(uint64_t value) NOEXCEPT;
+        histogram_snapshot get_snapshot() const;
+
+        static size_t get_bucket(uint64_t value) NOEXCEPT;
+
+        /**
+         * Smallest value that goes to a bucket
+         */
+        static uint64_t get_bucket_value(size_t bucket) NOEXCEPT;
+    };
+
+    /**
+     * Counters and histograms of a dispatcher, times are in nanoseconds
+     */
+    struct dispatcher_metrics
+    {
+        /**
+         * tasks added to the queues
+         */
+        uint64_t pushed;
+
+        /**
+         * times a task was taken out of a queue to run it
+         */
+        uint64_t popped;
+
+        /**
+         * times a task was taken out but its retry said it was not ready
+         */
+        uint64_t not_ready;
+
+        size_t queue_size;
+        size_t waiting_size;
+
+        /**
+         * time between a task being added and starting to run,
+         * for tasks that were not ready it includes the time they waited
+         */
+        histogram_snapshot wait_time;
+
+        /**
+         * time that the ready tasks took to run
+         */
+        histogram_snapshot run_time;
+
+        dispatcher_metrics();
+    };
+
+    /**
+     * Records the metrics of a dispatcher
+     */
+    class metrics_recorder
+    {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+    private:
+        std::atomic<uint64_t> _pushed;
+        std::atomic<uint64_t> _popped;
+        std::atomic<uint64_t> _not_ready;
+        histogram _wait_time;
+        histogram _run_time;
+
+    public:
+        metrics_recorder();
+
+        void record_push(size_t count=1) NOEXCEPT;
+        void record_process(const clock::duration& wait, const clock::duration& run, bool ready) NOEXCEPT;
+        void get_metrics(dispatcher_metrics& m) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef _eventually_parallel_hpp_
+#define _eventually_parallel_hpp_
+
+#include <eventually/define.hpp>
+#include <eventually/dispatcher.hpp>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace eventually {
+
+    /**
+     * Splits a range in chunks of grain size and processes them
+     * in the dispatcher. The range is halved recursively, each task
+     * queues the upper half and goes on with the lower one, so idle
+     * threads take big pieces of work and busy threads do not split more
+     * than needed. The calling thread processes the first half and
+     * then helps with the dispatcher tasks until all the chunks are done.
+     */
+    class parallel_worker
+    {
+    private:
+        parallel_worker();
+
+        struct state
+        {
+            std::atomic<size_t> remaining;
+            std::atomic<bool> failed;
+            std::mutex mutex;
+            std::exception_ptr exception;
+
+            state(size_t chunks):
+            remaining(chunks), failed(false)
+            {
+            }
+
+            void fail(std::exception_ptr e) NOEXCEPT
+            {
+                std::lock_guard<std::mutex> lock_(mutex);
+                if(!failed.load())
+                {
+                    exception = e;
+                    failed.store(true);
+                }
+            }
+        };
+
+        /**
+         * The task that processes the upper half of a range. If it is
+         * destroyed without running, for example because the dispatcher
+         * is destroyed, its chunks count as done and the run fails,
+         * so the calling thread does not wait for them forever.
+         */
+        template<typename Chunk>
+        class split_task
+        {
+        private:
+            dispatcher* _dispatcher;
+            state* _state;
+            const Chunk* _chunk;
+            size_t _begin;
+            size_t _end;
+
+            split_task(const split_task&);
+            split_task& operator=(const split_task&);
+
+        public:
+            split_task(dispatcher& d, state& s, const Chunk& chunk, size_t begin, size_t end) NOEXCEPT:
+            _dispatcher(&d), _state(&s), _chunk(&chunk), _begin(begin), _end(end)
+            {
+            }
+
+            split_task(split_task&& other) NOEXCEPT:
+            _dispatcher(other._dispatcher), _state(other._state), _chunk(other._chunk),
+            _begin(other._begin), _end(other._end)
+            {
+                other._state = nullptr;
+            }
+
+            ~split_task()
+            {
+                if(_state)
+                {
+                    _state->fail(std::make_exception_ptr(
+                        std::future_error(std::future_errc::broken_promise)));
+                    // nothing of the state can be used after this
+                    _state->remaining.fetch_sub(_end - _begin, std::memory_order_acq_rel);
+                }
+            }
+
+            void operator()()
+            {
+                state* s = _state;
+                _state = nullptr;
+                split(*_dispatcher, *s, *_chunk, _begin, _end);
+            }
+        };
+
+        template<typename Chunk>
+        static void split(dispatcher& d, state& s, const Chunk& chunk, size_t begin, size_t end)
+        {
+            while(end - begin > 1)
+            {
+                size_t mid = begin + (end - begin) / 2;
+                d.dispatch(split_task<Chunk>(d, s, chunk, mid, end));
+                end = mid;
+            }
+            if(!s.failed.load(std::memory_order_relaxed))
+            {
+                try
+                {
+                    chunk(begin);
+                }
+                catch(...)
+                {
+                    s.fail(std::current_exception());
+                }
+            }
+            // nothing of the state can be used after this
+            s.remaining.fetch_sub(1, std::memory_order_acq_rel);
+        }
+
+    public:
+
+        /**
+         * The default grain gives every thread a few chunks
+         */
+        static size_t get_grain(size_t size, size_t grain) NOEXCEPT
+        {
+            if(grain > 0)
+            {
+                return grain;
+            }
+            size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            return std::max<size_t>(size / (8 * threads), 1);
+        }
+
+        static size_t get_chunks(size_t size, size_t grain) NOEXCEPT
+        {
+            return (size + grain - 1) / grain;
+        }
+
+        /**
+         * Call chunk(i) for every i in [0, chunks) and wait for all of them.
+         * Rethrows the first exception thrown by a chunk,
+         * the chunks that did not start yet are skipped.
+         * Throws std::future_error with broken_promise
+         * if the dispatcher dropped some of the chunks.
+         */
+        template<typename Chunk>
+        static void run(dispatcher& d, size_t chunks, const Chunk& chunk)
+        {
+            if(chunks == 0)
+            {
+                return;
+            }
+            state s(chunks);
+            split(d, s, chunk, 0, chunks);
+            while(s.remaining.load(std::memory_order_acquire) > 0)
+            {
+                if(!d.process_one())
+                {
+                    std::this_thread::yield();
+                }
+            }
+            if(s.exception)
+            {
+                std::rethrow_exception(s.exception);
+            }
+        }
+
+        template<typename Index,
+            typename std::enable_if<std::is_integral<Index>::value, int>::type = 0>
+        static Index at(Index first, size_t i) NOEXCEPT
+        {
+            return first + i;
+        }
+
+        template<typename Iterator,
+            typename std::enable_if<!std::is_integral<Iterator>::value, int>::type = 0>
+        static auto at(Iterator first, size_t i) -> decltype(*first)
+        {
+            return first[i];
+        }
+    };
+
+    /**
+     * Call a function for every element of a range in parallel.
+     * The calling thread helps processing the dispatcher tasks until it is done.
+     * @param dispatcher where the chunks are processed
+     * @param first random access iterator or integer index
+     * @param last end of the range
+     * @param body function called with every element (or index)
+     * @param grain amount of elements processed by a task, 0 to pick one
+     */
+    template<typename Iterator, typename Body>
+    void parallel_for(dispatcher& d, Iterator first, Iterator last, Body&& body, size_t grain=0)
+    {
+        if(!(first < last))
+        {
+            return;
+        }
+        size_t size = last - first;
+        grain = parallel_worker::get_grain(size, grain);
+        parallel_worker::run(d, parallel_worker::get_chunks(size, grain),
+            [first, size, grain, &body](size_t chunk){
+                size_t end = std::min(size, (chunk + 1) * grain);
+                for(size_t i = chunk * grain; i < end; ++i)
+                {
+                    body(parallel_worker::at(first, i));
+                }
+            });
+    }
+
+    /**
+     * Store the result of a function for every element of a range in parallel.
+     * @param dispatcher where the chunks are processed
+     * @param first random access iterator
+     * @param last end of the range
+     * @param out random access iterator where the results are stored
+     * @param op function called with every element
+     * @param grain amount of elements processed by a task, 0 to pick one
+     * @return iterator past the last stored result
+     */
+    template<typename Iterator, typename OutputIterator, typename Op>
+    OutputIterator parallel_transform(dispatcher& d, Iterator first, Iterator last, OutputIterator out, Op&& op, size_t grain=0)
+    {
+        if(!(first < last))
+        {
+            return out;
+        }
+        size_t size = last - first;
+        grain = parallel_worker::get_grain(size, grain);
+        parallel_worker::run(d, parallel_worker::get_chunks(size, grain),
+            [first, out, size, grain, &op](size_t chunk){
+                size_t end = std::min(size, (chunk + 1) * grain);
+                for(size_t i = chunk * grain; i < end; ++i)
+                {
+                    out[i] = op(first[i]);
+                }
+            });
+        return out + size;
+    }
+
+    /**
+     * Combine all the elements of a range in parallel.
+     * Every chunk is reduced on its own and the chunk results are combined
+     * in order after init, so the operation has to be associative.
+     * @param dispatcher where the chunks are processed
+     * @param first random access iterator
+     * @param last end of the range
+     * @param init initial value
+     * @param op binary function that combines two values
+     * @param grain amount of elements processed by a task, 0 to pick one
+     */
+    template<typename Iterator, typename T, typename Op>
+    T parallel_reduce(dispatcher& d, Iterator first, Iterator last, T init, Op&& op, size_t grain=0)
+    {
+        if(!(first < last))
+        {
+            return init;
+        }
+        size_t size = last - first;
+        grain = parallel_worker::get_grain(size, grain);
+        size_t chunks = parallel_worker::get_chunks(size, grain);
+        std::vector<T> results(chunks, init);
+        parallel_worker::run(d, chunks,
+            [first, size, grain, &op, &results](size_t chunk){
+                size_t begin = chunk * grain;
+                size_t end = std::min(size, begin + grain);
+                T result = first[begin];
+                for(size_t i = begin + 1; i < end; ++i)
+                {
+                    result = op(std::move(result), first[i]);
+                }
+                results[chunk] = std::move(result);
+            });
+        for(auto& result : results)
+        {
+            init = op(std::move(init), std::move(result));
+        }
+        return init;
+    }
+
+}
+
+#endif
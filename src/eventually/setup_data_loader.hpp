@@ -54,7 +54,7 @@ namespace eventually {
             _data_setup = setup;
         }
 
-        std::future<data> load(connection& c, const std::string& name)
+        future<data> load(connection& c, const std::string& name)
         {
             if(!_loader)
             {
@@ -74,7 +74,7 @@ namespace eventually {
             }, _loader->load(c, sname));
         }
 
-        std::future<data> load(const std::string& name)
+        future<data> load(const std::string& name)
         {
             connection conn;
             return load(conn, name);
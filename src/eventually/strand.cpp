@@ -0,0 +1,240 @@
+
+#include <eventually/strand.hpp>
+#include <condition_variable>
+#include <mutex>
+
+namespace eventually {
+
+    namespace {
+
+        /**
+         * The strand whose tasks are running in the current thread
+         */
+        thread_local strand* current = nullptr;
+
+        struct current_scope
+        {
+            strand* previous;
+
+            current_scope(strand* s):
+            previous(current)
+            {
+                current = s;
+            }
+
+            ~current_scope()
+            {
+                current = previous;
+            }
+        };
+    }
+
+    const size_t strand::default_batch_size = 64;
+
+    /**
+     * Shared with the tasks dispatched to the target,
+     * so that they do nothing once the strand is destroyed.
+     * The mutex is only held to check the strand and count
+     * the running tasks, never while the strand tasks run.
+     */
+    struct strand::state
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        strand* target;
+        size_t running;
+
+        state(strand* s):
+        target(s), running(0)
+        {
+        }
+    };
+
+    /**
+     * Runs a batch of the strand tasks in the target dispatcher.
+     * Wake tasks are the timers that look for expired strand timers
+     * or waiting tasks to retry.
+     */
+    class strand::run_task : public basic_task
+    {
+    private:
+        std::shared_ptr<state> _state;
+        bool _wake;
+
+    public:
+        run_task(const std::shared_ptr<state>& s, bool wake):
+        _state(s), _wake(wake)
+        {
+        }
+
+        static void* operator new(size_t size)
+        {
+            return task_pool::allocate(size);
+        }
+
+        static void operator delete(void* p, size_t size) NOEXCEPT
+        {
+            task_pool::deallocate(p, size);
+        }
+
+        bool operator()()
+        {
+            strand* s = nullptr;
+            {
+                std::lock_guard<std::mutex> lock_(_state->mutex);
+                s = _state->target;
+                if(!s)
+                {
+                    return true;
+                }
+                ++_state->running;
+            }
+            if(_wake)
+            {
+                s->wake();
+            }
+            else
+            {
+                s->drain();
+            }
+            std::lock_guard<std::mutex> lock_(_state->mutex);
+            if(--_state->running == 0)
+            {
+                _state->done.notify_all();
+            }
+            return true;
+        }
+    };
+
+    strand::strand(dispatcher& target, size_t batch_size):
+    dispatcher(new locked_task_queue()),
+    _target(target), _batch_size(batch_size > 0 ? batch_size : 1),
+    _state(std::make_shared<state>(this))
+    {
+        _scheduled.store(false);
+        _wake.store(clock::time_point::max().time_since_epoch().count());
+    }
+
+    strand::~strand()
+    {
+        unlink();
+        std::unique_lock<std::mutex> lock_(_state->mutex);
+        _state->target = nullptr;
+        // waits for a batch that is running in the target
+        _state->done.wait(lock_, [this](){
+            return _state->running == 0;
+        });
+    }
+
+    void strand::schedule() NOEXCEPT
+    {
+        if(_scheduled.exchange(true))
+        {
+            return;
+        }
+        _target.push_task(basic_task_ptr(new run_task(_state, false)));
+    }
+
+    void strand::schedule_wake(const clock::time_point& time) NOEXCEPT
+    {
+        clock::rep t = time.time_since_epoch().count();
+        clock::rep current = _wake.load();
+        while(t < current)
+        {
+            // only the earliest wake is dispatched, it looks for the next one
+            if(_wake.compare_exchange_weak(current, t))
+            {
+                _target.push_timer(time, basic_task_ptr(new run_task(_state, true)));
+                return;
+            }
+        }
+    }
+
+    void strand::wake() NOEXCEPT
+    {
+        _wake.store(clock::time_point::max().time_since_epoch().count());
+        if(!_scheduled.exchange(true))
+        {
+            drain();
+        }
+    }
+
+    void strand::drain() NOEXCEPT
+    {
+        {
+            current_scope scope_(this);
+            size_t count = 0;
+            while(count < _batch_size && process_next())
+            {
+                ++count;
+            }
+        }
+        release();
+    }
+
+    void strand::release() NOEXCEPT
+    {
+        _scheduled.store(false);
+        // tasks pushed while the batch was running
+        // did not dispatch the strand again
+        if(get_queue_size() > 0)
+        {
+            schedule();
+        }
+        else if(has_waiting_tasks())
+        {
+            schedule_wake(clock::now() + get_retry_interval());
+        }
+        auto next = get_next_timer();
+        if(next != clock::time_point::max())
+        {
+            schedule_wake(next);
+        }
+    }
+
+    bool strand::process_one() NOEXCEPT
+    {
+        if(current == this)
+        {
+            // a task of the strand that waits for other tasks already owns it
+            return dispatcher::process_one();
+        }
+        if(_scheduled.exchange(true))
+        {
+            // the target is running the strand
+            return false;
+        }
+        bool result_;
+        {
+            current_scope scope_(this);
+            result_ = dispatcher::process_one();
+        }
+        release();
+        return result_;
+    }
+
+    void strand::notify_tasks(size_t count) NOEXCEPT
+    {
+        if(count > 0)
+        {
+            schedule();
+        }
+    }
+
+    void strand::push_timer(const clock::time_point& time, basic_task_ptr&& t) NOEXCEPT
+    {
+        dispatcher::push_timer(time, std::move(t));
+        schedule_wake(get_next_timer());
+    }
+
+    dispatcher& strand::get_target() const NOEXCEPT
+    {
+        return _target;
+    }
+
+    bool strand::is_scheduled() const NOEXCEPT
+    {
+        return _scheduled.load();
+    }
+
+}
@@ -0,0 +1,95 @@
+#ifndef _eventually_strand_hpp_
+#define _eventually_strand_hpp_
+
+#include <eventually/dispatcher.hpp>
+#include <atomic>
+#include <memory>
+
+namespace eventually {
+
+    /**
+     * A dispatcher that runs its tasks one at a time and in order
+     * on the threads of another dispatcher, usually a thread_dispatcher.
+     * Tasks are stored in a fifo queue. When the strand gets work it dispatches
+     * a single task to the target that processes up to batch_size tasks
+     * and dispatches itself again if more are left, so a strand never uses
+     * more than one thread and does not need a thread of its own.
+     * Task priorities are ignored. Tasks that are not ready are parked
+     * like in any dispatcher and do not block the rest of the strand.
+     * A batch owns the strand while _scheduled is set, and calling
+     * process_one or process_all only runs a task if no batch is dispatched.
+     * The target has to outlive the strand and a strand should not
+     * be destroyed from one of its own tasks.
+     */
+    class strand : public dispatcher
+    {
+    public:
+        static const size_t default_batch_size;
+
+    private:
+        struct state;
+        class run_task;
+
+        dispatcher& _target;
+        size_t _batch_size;
+        std::atomic_bool _scheduled;
+        std::atomic<clock::rep> _wake;
+        std::shared_ptr<state> _state;
+
+        strand(const strand&);
+        strand& operator=(const strand&);
+
+        void schedule() NOEXCEPT;
+        void schedule_wake(const clock::time_point& time) NOEXCEPT;
+        void wake() NOEXCEPT;
+        void drain() NOEXCEPT;
+
+        /**
+         * Give up the ownership of the strand and dispatch
+         * it again if there are tasks or timers left
+         */
+        void release() NOEXCEPT;
+
+        /**
+         * Hidden because it would run the tasks without owning the strand
+         */
+        using dispatcher::process_until;
+
+    protected:
+        /**
+         * Dispatch the strand to the target if it is not already
+         */
+        void notify_tasks(size_t count) NOEXCEPT;
+
+        /**
+         * Timers are stored in the strand and the target
+         * wakes the strand up when the first one is due
+         */
+        void push_timer(const clock::time_point& time, basic_task_ptr&& t) NOEXCEPT;
+
+    public:
+        /**
+         * @param target dispatcher where the tasks are run
+         * @param batch_size tasks run every time the strand is dispatched
+         */
+        strand(dispatcher& target, size_t batch_size=default_batch_size);
+        ~strand();
+
+        dispatcher& get_target() const NOEXCEPT;
+
+        /**
+         * True while the strand is dispatched to the target
+         */
+        bool is_scheduled() const NOEXCEPT;
+
+        /**
+         * Process a task if the strand is not dispatched to the target
+         * or if it is called from one of the strand tasks
+         * @return false if the target is running the strand
+         */
+        bool process_one() NOEXCEPT;
+    };
+
+}
+
+#endif
@@ -3,7 +3,46 @@
 
 namespace eventually {
 
+    basic_task::basic_task():
+    _priority(task_priority::normal)
+    {
+#ifdef EVENTUALLY_TRACE
+        // the label of the thread that created the task, not the one that pushes it
+        _trace.label = trace_label::get_current();
+#endif
+    }
+
     basic_task::~basic_task()
     {
     }
+
+    task_priority basic_task::get_priority() const NOEXCEPT
+    {
+        return _priority;
+    }
+
+    void basic_task::set_priority(task_priority p) NOEXCEPT
+    {
+        _priority = p;
+    }
+
+    bool basic_task::interrupted() const NOEXCEPT
+    {
+        return false;
+    }
+
+    const std::chrono::steady_clock::time_point& basic_task::get_push_time() const NOEXCEPT
+    {
+        return _push_time;
+    }
+
+    void basic_task::set_push_time(const std::chrono::steady_clock::time_point& time) NOEXCEPT
+    {
+        _push_time = time;
+    }
+
+    task_trace& basic_task::get_trace() NOEXCEPT
+    {
+        return _trace;
+    }
 }
\ No newline at end of file
@@ -2,69 +2,137 @@
 #ifndef _eventually_task_hpp_
 #define _eventually_task_hpp_
 
+#include <chrono>
 #include <future>
 #include <memory>
 #include <eventually/define.hpp>
 #include <eventually/connection.hpp>
+#include <eventually/future.hpp>
 #include <eventually/handler.hpp>
 #include <eventually/is_callable.hpp>
+#include <eventually/task_pool.hpp>
+#include <eventually/tracer.hpp>
 #include <eventually/worker.hpp>
 
 namespace eventually {
 
+    /**
+     * Order in which the queues that support it process the tasks
+     */
+    enum class task_priority
+    {
+        low,
+        normal,
+        high
+    };
+
+    static const size_t task_priority_count = 3;
+
     /**
      * A basic interface to store tasks of different results
      * in the same dispatcher
      */
     class basic_task
     {
+    private:
+        task_priority _priority;
+        std::chrono::steady_clock::time_point _push_time;
+        task_trace _trace;
+
     public:
+        basic_task();
         virtual ~basic_task();
         virtual bool operator()() = 0;
+
+        task_priority get_priority() const NOEXCEPT;
+        void set_priority(task_priority p) NOEXCEPT;
+
+        /**
+         * True if the connection of the task was interrupted,
+         * running it then only fulfills its future with connection_interrupted
+         */
+        virtual bool interrupted() const NOEXCEPT;
+
+        /**
+         * When the task was added to a dispatcher queue,
+         * only set if the library is built with EVENTUALLY_METRICS
+         */
+        const std::chrono::steady_clock::time_point& get_push_time() const NOEXCEPT;
+        void set_push_time(const std::chrono::steady_clock::time_point& time) NOEXCEPT;
+
+        task_trace& get_trace() NOEXCEPT;
     };
 
+    typedef std::unique_ptr<basic_task> basic_task_ptr;
+
     /**
-     * A container for a std::promise and the
-     * associated work, handler and connection
+     * A container for a promise and the
+     * associated work, handler and connection.
+     * The promise is fulfilled when the work is done
+     * and broken when the task is destroyed before that.
+     * Tasks and the shared state of their promise are stored in the task pool.
+     * With a null_connection the task does not lock or check for interruption.
      */
-    template<class Retry, class Work, class... Args>
+    template<class Connection, class Retry, class Work, class... Args>
     class task : public basic_task
     {
     private:
         typedef typename result_of<Work(Args&&...)>::type result;
-        connection _connection;
+        Connection _connection;
         Retry _retry;
         Work _work;
         handler<Args...> _handler;
-        std::promise<result> _promise;
+        promise<result> _promise;
 
     public:
 
-        task(connection& c, Retry&& r, Work&& w, Args&&... args):
+        task(Connection& c, Retry&& r, Work&& w, Args&&... args):
         _connection(c),
         _retry(std::forward<Retry>(r)),
         _work(std::forward<Work>(w)),
         _handler(std::forward<Args>(args)...)
         {
+            _promise.set_connection(_connection);
+        }
+
+        static void* operator new(size_t size)
+        {
+            return task_pool::allocate(size);
         }
 
-        std::future<result> get_future()
+        static void operator delete(void* p, size_t size) NOEXCEPT
+        {
+            task_pool::deallocate(p, size);
+        }
+
+        future<result> get_future()
         {
             return _promise.get_future();
         }
 
-        const connection& get_connection() const
+        const Connection& get_connection() const
         {
             return _connection;
         }
 
-        connection& get_connection()
+        Connection& get_connection()
         {
             return _connection;
         }
 
+        bool interrupted() const NOEXCEPT
+        {
+            return _connection.interrupted();
+        }
+
         bool operator()()
         {
+            // interrupted tasks do not wait to be ready and do not throw
+            if(_connection.interrupted())
+            {
+                _promise.set_exception(std::make_exception_ptr(connection_interrupted()));
+                return true;
+            }
             if(!_handler(_retry, _connection))
             {
                 return false;
@@ -79,19 +147,32 @@ namespace eventually {
      * Helper method to generate tasks
      */
     template <typename Retry, typename Work, typename... Args>
-    auto make_task(connection& c, Retry&& r, Work&& w, Args&&... args) -> task<Retry, Work, Args...>
+    auto make_task(connection& c, Retry&& r, Work&& w, Args&&... args) -> task<connection, Retry, Work, Args...>
     {
-        return task<Retry, Work, Args...>(c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...);
+        return task<connection, Retry, Work, Args...>(c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...);
+    }
+
+    template <typename Retry, typename Work, typename... Args>
+    auto make_task(null_connection& c, Retry&& r, Work&& w, Args&&... args) -> task<null_connection, Retry, Work, Args...>
+    {
+        return task<null_connection, Retry, Work, Args...>(c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...);
     }
 
     /**
      * Helper method to generate task pointers
      */
     template <typename Retry, typename Work, typename... Args>
-    auto make_task_ptr(connection& c, Retry&& r, Work&& w, Args&&... args) -> std::unique_ptr<task<Retry, Work, Args...>>
+    auto make_task_ptr(connection& c, Retry&& r, Work&& w, Args&&... args) -> std::unique_ptr<task<connection, Retry, Work, Args...>>
+    {
+        return std::unique_ptr<task<connection, Retry, Work, Args...>>(
+                new task<connection, Retry, Work, Args...>(c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...));
+    }
+
+    template <typename Retry, typename Work, typename... Args>
+    auto make_task_ptr(null_connection& c, Retry&& r, Work&& w, Args&&... args) -> std::unique_ptr<task<null_connection, Retry, Work, Args...>>
     {
-        return std::unique_ptr<task<Retry, Work, Args...>>(
-                new task<Retry, Work, Args...>(c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...));
+        return std::unique_ptr<task<null_connection, Retry, Work, Args...>>(
+                new task<null_connection, Retry, Work, Args...>(c, std::forward<Retry>(r), std::forward<Work>(w), std::forward<Args>(args)...));
     }
 
 }
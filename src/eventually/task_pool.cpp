@@ -0,0 +1,156 @@
+
+#include <eventually/task_pool.hpp>
+#include <mutex>
+
+namespace eventually {
+
+    namespace {
+
+        const size_t class_count = task_pool::max_size / task_pool::granularity;
+
+        /**
+         * A free block, batches in the global list are linked by their first block
+         */
+        struct block
+        {
+            block* next;
+            block* next_batch;
+        };
+
+        struct global_pool
+        {
+            std::mutex mutex;
+            block* batches[class_count];
+        };
+
+        /**
+         * Never destroyed so that it can be used by thread exit handlers
+         */
+        global_pool& get_global_pool()
+        {
+            static global_pool* pool = new global_pool();
+            return *pool;
+        }
+
+        void push_batch(size_t i, block* b) NOEXCEPT
+        {
+            global_pool& pool = get_global_pool();
+            std::lock_guard<std::mutex> lock_(pool.mutex);
+            b->next_batch = pool.batches[i];
+            pool.batches[i] = b;
+        }
+
+        block* pop_batch(size_t i) NOEXCEPT
+        {
+            global_pool& pool = get_global_pool();
+            std::lock_guard<std::mutex> lock_(pool.mutex);
+            block* b = pool.batches[i];
+            if(b)
+            {
+                pool.batches[i] = b->next_batch;
+            }
+            return b;
+        }
+
+        /**
+         * Trivial so that it can still be used after the thread exit handlers
+         */
+        struct thread_cache
+        {
+            block* heads[class_count];
+            size_t sizes[class_count];
+            bool closed;
+        };
+
+        thread_local thread_cache cache;
+
+        /**
+         * Gives the blocks of the thread back to the global list when it exits
+         */
+        struct thread_cache_guard
+        {
+            ~thread_cache_guard()
+            {
+                for(size_t i=0; i<class_count; ++i)
+                {
+                    if(cache.heads[i])
+                    {
+                        push_batch(i, cache.heads[i]);
+                        cache.heads[i] = nullptr;
+                        cache.sizes[i] = 0;
+                    }
+                }
+                cache.closed = true;
+            }
+        };
+
+        thread_local thread_cache_guard cache_guard;
+
+        size_t get_class(size_t size) NOEXCEPT
+        {
+            return size == 0 ? 0 : (size-1) / task_pool::granularity;
+        }
+    }
+
+    void* task_pool::allocate(size_t size)
+    {
+        if(size > max_size || cache.closed)
+        {
+            return ::operator new(size);
+        }
+        size_t i = get_class(size);
+        block* b = cache.heads[i];
+        if(!b)
+        {
+            // touch the guard so that it is constructed in this thread
+            (void)&cache_guard;
+            b = pop_batch(i);
+            if(!b)
+            {
+                return ::operator new((i+1)*granularity);
+            }
+            size_t n = 0;
+            for(block* c = b; c; c = c->next)
+            {
+                ++n;
+            }
+            cache.sizes[i] = n;
+        }
+        cache.heads[i] = b->next;
+        cache.sizes[i]--;
+        return b;
+    }
+
+    void task_pool::deallocate(void* p, size_t size) NOEXCEPT
+    {
+        if(!p)
+        {
+            return;
+        }
+        if(size > max_size || cache.closed)
+        {
+            ::operator delete(p);
+            return;
+        }
+        size_t i = get_class(size);
+        (void)&cache_guard;
+        block* b = static_cast<block*>(p);
+        b->next = cache.heads[i];
+        cache.heads[i] = b;
+        if(++cache.sizes[i] <= cache_size)
+        {
+            return;
+        }
+        // give a batch to the global list
+        block* last = b;
+        for(size_t n=1; n<batch_size; ++n)
+        {
+            last = last->next;
+        }
+        cache.heads[i] = last->next;
+        cache.sizes[i] -= batch_size;
+        last->next = nullptr;
+        push_batch(i, b);
+    }
+
+}
@@ -0,0 +1,73 @@
+#ifndef _eventually_task_pool_hpp_
+#define _eventually_task_pool_hpp_
+
+#include <eventually/define.hpp>
+#include <cstddef>
+#include <new>
+
+namespace eventually {
+
+    /**
+     * A pool of small memory blocks used to store tasks
+     * and their shared states so that dispatching them does not allocate.
+     * Each thread keeps a cache of free blocks for every size and
+     * exchanges batches of them with a global list, so blocks freed
+     * in the worker threads can be reused by the dispatching threads.
+     * Bigger blocks are allocated with operator new.
+     */
+    class task_pool
+    {
+    public:
+        static const size_t granularity = 16;
+        static const size_t max_size = 512;
+        static const size_t cache_size = 64;
+        static const size_t batch_size = 32;
+
+        static void* allocate(size_t size);
+        static void deallocate(void* p, size_t size) NOEXCEPT;
+    };
+
+    /**
+     * An allocator that uses the task pool
+     */
+    template<typename T>
+    class task_pool_allocator
+    {
+    public:
+        typedef T value_type;
+
+        task_pool_allocator() NOEXCEPT
+        {
+        }
+
+        template<typename U>
+        task_pool_allocator(const task_pool_allocator<U>&) NOEXCEPT
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            return static_cast<T*>(task_pool::allocate(n*sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t n) NOEXCEPT
+        {
+            task_pool::deallocate(p, n*sizeof(T));
+        }
+    };
+
+    template<typename T, typename U>
+    bool operator==(const task_pool_allocator<T>&, const task_pool_allocator<U>&) NOEXCEPT
+    {
+        return true;
+    }
+
+    template<typename T, typename U>
+    bool operator!=(const task_pool_allocator<T>&, const task_pool_allocator<U>&) NOEXCEPT
+    {
+        return false;
+    }
+
+}
+
+#endif
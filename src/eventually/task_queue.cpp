@@ -0,0 +1,319 @@
+
+#include <eventually/task_queue.hpp>
+#include <cstdint>
+
+namespace eventually {
+
+    task_queue::~task_queue()
+    {
+    }
+
+    void task_queue::push(std::vector<basic_task_ptr>&& ts) NOEXCEPT
+    {
+        for(auto& t : ts)
+        {
+            push(std::move(t));
+        }
+        ts.clear();
+    }
+
+    size_t task_queue::purge(std::vector<basic_task_ptr>& purged) NOEXCEPT
+    {
+        size_t count = 0;
+        std::vector<basic_task_ptr> kept;
+        basic_task_ptr t;
+        while(pop(t))
+        {
+            if(t->interrupted())
+            {
+                purged.push_back(std::move(t));
+                ++count;
+            }
+            else
+            {
+                kept.push_back(std::move(t));
+            }
+        }
+        push(std::move(kept));
+        return count;
+    }
+
+    void locked_task_queue::push(basic_task_ptr&& t) NOEXCEPT
+    {
+        std::lock_guard<std::mutex> lock_(_mutex);
+        _tasks.push_back(std::move(t));
+    }
+
+    void locked_task_queue::push(std::vector<basic_task_ptr>&& ts) NOEXCEPT
+    {
+        {
+            std::lock_guard<std::mutex> lock_(_mutex);
+            for(auto& t : ts)
+            {
+                _tasks.push_back(std::move(t));
+            }
+        }
+        ts.clear();
+    }
+
+    bool locked_task_queue::pop(basic_task_ptr& t) NOEXCEPT
+    {
+        std::lock_guard<std::mutex> lock_(_mutex);
+        if(_tasks.empty())
+        {
+            return false;
+        }
+        t = std::move(_tasks.front());
+        _tasks.pop_front();
+        return true;
+    }
+
+    size_t locked_task_queue::purge(std::vector<basic_task_ptr>& purged) NOEXCEPT
+    {
+        std::lock_guard<std::mutex> lock_(_mutex);
+        size_t count = 0;
+        auto last = _tasks.begin();
+        for(auto itr = _tasks.begin(); itr != _tasks.end(); ++itr)
+        {
+            if((*itr)->interrupted())
+            {
+                purged.push_back(std::move(*itr));
+                ++count;
+            }
+            else
+            {
+                *last++ = std::move(*itr);
+            }
+        }
+        _tasks.erase(last, _tasks.end());
+        return count;
+    }
+
+    priority_task_queue::priority_task_queue(const clock::duration& aging):
+    _aging(aging)
+    {
+    }
+
+    void priority_task_queue::push_locked(basic_task_ptr&& t, const clock::time_point& now)
+    {
+        size_t level = (size_t)t->get_priority();
+        _levels[level].push_back(entry());
+        _levels[level].back().task = std::move(t);
+        _levels[level].back().time = now;
+    }
+
+    void priority_task_queue::push(basic_task_ptr&& t) NOEXCEPT
+    {
+        // the time is only needed for aging
+        clock::time_point now;
+        if(_aging != clock::duration::zero())
+        {
+            now = clock::now();
+        }
+        std::lock_guard<std::mutex> lock_(_mutex);
+        push_locked(std::move(t), now);
+    }
+
+    void priority_task_queue::push(std::vector<basic_task_ptr>&& ts) NOEXCEPT
+    {
+        clock::time_point now;
+        if(_aging != clock::duration::zero())
+        {
+            now = clock::now();
+        }
+        {
+            std::lock_guard<std::mutex> lock_(_mutex);
+            for(auto& t : ts)
+            {
+                push_locked(std::move(t), now);
+            }
+        }
+        ts.clear();
+    }
+
+    bool priority_task_queue::pop(basic_task_ptr& t) NOEXCEPT
+    {
+        std::lock_guard<std::mutex> lock_(_mutex);
+        size_t level = task_priority_count;
+        while(level > 0 && _levels[level-1].empty())
+        {
+            --level;
+        }
+        if(level == 0)
+        {
+            return false;
+        }
+        --level;
+        if(_aging != clock::duration::zero() && level > 0)
+        {
+            // take the oldest of the lower priority tasks that waited too long
+            auto oldest = clock::now() - _aging;
+            size_t top = level;
+            for(size_t i=0; i<top; ++i)
+            {
+                if(!_levels[i].empty() && _levels[i].front().time <= oldest)
+                {
+                    oldest = _levels[i].front().time;
+                    level = i;
+                }
+            }
+        }
+        t = std::move(_levels[level].front().task);
+        _levels[level].pop_front();
+        return true;
+    }
+
+    size_t priority_task_queue::purge(std::vector<basic_task_ptr>& purged) NOEXCEPT
+    {
+        std::lock_guard<std::mutex> lock_(_mutex);
+        size_t count = 0;
+        for(auto& tasks : _levels)
+        {
+            auto last = tasks.begin();
+            for(auto itr = tasks.begin(); itr != tasks.end(); ++itr)
+            {
+                if(itr->task->interrupted())
+                {
+                    purged.push_back(std::move(itr->task));
+                    ++count;
+                }
+                else
+                {
+                    *last++ = std::move(*itr);
+                }
+            }
+            tasks.erase(last, tasks.end());
+        }
+        return count;
+    }
+
+    const size_t lockfree_task_queue::default_capacity = 1 << 14;
+
+    lockfree_task_queue::lockfree_task_queue(size_t capacity)
+    {
+        size_t size = 2;
+        while(size < capacity)
+        {
+            size <<= 1;
+        }
+        _mask = size - 1;
+        _cells.reset(new cell[size]);
+        for(size_t i=0; i<size; ++i)
+        {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+            _cells[i].task = nullptr;
+        }
+        _enqueue_pos.store(0, std::memory_order_relaxed);
+        _dequeue_pos.store(0, std::memory_order_relaxed);
+        _overflow_size.store(0, std::memory_order_relaxed);
+    }
+
+    lockfree_task_queue::~lockfree_task_queue()
+    {
+        basic_task_ptr t;
+        while(pop(t))
+        {
+            t.reset();
+        }
+    }
+
+    size_t lockfree_task_queue::capacity() const NOEXCEPT
+    {
+        return _mask + 1;
+    }
+
+    bool lockfree_task_queue::try_push(basic_task_ptr& t) NOEXCEPT
+    {
+        cell* c;
+        size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            c = &_cells[pos & _mask];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if(dif == 0)
+            {
+                if(_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(dif < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        c->task = t.release();
+        c->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    void lockfree_task_queue::push(basic_task_ptr&& t) NOEXCEPT
+    {
+        // once tasks overflow the next ones go after them to keep the order
+        if(_overflow_size.load(std::memory_order_acquire) == 0 && try_push(t))
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock_(_overflow_mutex);
+        _overflow.push_back(std::move(t));
+        _overflow_size.store(_overflow.size(), std::memory_order_release);
+    }
+
+    bool lockfree_task_queue::pop(basic_task_ptr& t) NOEXCEPT
+    {
+        if(pop_ring(t))
+        {
+            return true;
+        }
+        if(_overflow_size.load(std::memory_order_acquire) == 0)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock_(_overflow_mutex);
+        if(_overflow.empty())
+        {
+            return false;
+        }
+        t = std::move(_overflow.front());
+        _overflow.pop_front();
+        _overflow_size.store(_overflow.size(), std::memory_order_release);
+        return true;
+    }
+
+    bool lockfree_task_queue::pop_ring(basic_task_ptr& t) NOEXCEPT
+    {
+        cell* c;
+        size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            c = &_cells[pos & _mask];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if(dif == 0)
+            {
+                if(_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(dif < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        t.reset(c->task);
+        c->task = nullptr;
+        c->sequence.store(pos + _mask + 1, std::memory_order_release);
+        return true;
+    }
+
+}
@@ -0,0 +1,177 @@
+#ifndef _eventually_task_queue_hpp_
+#define _eventually_task_queue_hpp_
+
+#include <eventually/define.hpp>
+#include <eventually/task.hpp>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace eventually {
+
+    /**
+     * Interface for the container where a dispatcher stores its tasks.
+     * Implementations have to be safe to use from many threads.
+     */
+    class task_queue
+    {
+    public:
+        virtual ~task_queue();
+
+        /**
+         * Add a task at the end of the queue
+         */
+        virtual void push(basic_task_ptr&& t) NOEXCEPT = 0;
+
+        /**
+         * Add a list of tasks at the end of the queue,
+         * by default pushing them one by one
+         */
+        virtual void push(std::vector<basic_task_ptr>&& ts) NOEXCEPT;
+
+        /**
+         * Take the task at the front of the queue
+         * @return false if the queue was empty
+         */
+        virtual bool pop(basic_task_ptr& t) NOEXCEPT = 0;
+
+        /**
+         * Move the tasks whose connection was interrupted out of the queue.
+         * By default all the tasks are popped and the rest pushed again.
+         * @return the amount of tasks that were moved
+         */
+        virtual size_t purge(std::vector<basic_task_ptr>& purged) NOEXCEPT;
+    };
+
+    /**
+     * A std::deque protected by a std::mutex.
+     * Ignores the task priorities.
+     */
+    class locked_task_queue : public task_queue
+    {
+    private:
+        std::mutex _mutex;
+        std::deque<basic_task_ptr> _tasks;
+
+    public:
+        void push(basic_task_ptr&& t) NOEXCEPT;
+
+        /**
+         * Add all the tasks locking the mutex once
+         */
+        void push(std::vector<basic_task_ptr>&& ts) NOEXCEPT;
+        bool pop(basic_task_ptr& t) NOEXCEPT;
+        size_t purge(std::vector<basic_task_ptr>& purged) NOEXCEPT;
+    };
+
+    /**
+     * A std::deque for every task priority protected by a std::mutex.
+     * Higher priority tasks are processed first and tasks of the same
+     * priority in order. With aging a lower priority task that waited
+     * longer than the aging time is processed before the higher ones,
+     * so low priority work can not starve.
+     * This is the default dispatcher queue.
+     */
+    class priority_task_queue : public task_queue
+    {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+    private:
+        struct entry
+        {
+            basic_task_ptr task;
+            clock::time_point time;
+        };
+
+        std::mutex _mutex;
+        std::deque<entry> _levels[task_priority_count];
+        clock::duration _aging;
+
+        void push_locked(basic_task_ptr&& t, const clock::time_point& now);
+
+    public:
+        /**
+         * @param aging time after which a waiting task is processed
+         * before higher priority ones, zero disables aging
+         */
+        priority_task_queue(const clock::duration& aging=clock::duration::zero());
+
+        void push(basic_task_ptr&& t) NOEXCEPT;
+        void push(std::vector<basic_task_ptr>&& ts) NOEXCEPT;
+        bool pop(basic_task_ptr& t) NOEXCEPT;
+        size_t purge(std::vector<basic_task_ptr>& purged) NOEXCEPT;
+    };
+
+    /**
+     * A bounded multiple producer multiple consumer queue that does
+     * not take locks, based on Dmitry Vyukov's bounded MPMC queue
+     * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+     * When the ring is full push moves the tasks to a locked overflow list,
+     * so the capacity should be bigger than the expected backlog
+     * but pushing never waits for a consumer.
+     * Ignores the task priorities.
+     */
+    class lockfree_task_queue : public task_queue
+    {
+    private:
+        struct cell
+        {
+            std::atomic<size_t> sequence;
+            basic_task* task;
+        };
+
+        static const size_t cache_line = 64;
+        typedef char cache_line_pad[cache_line];
+
+        cache_line_pad _pad0;
+        std::unique_ptr<cell[]> _cells;
+        size_t _mask;
+        cache_line_pad _pad1;
+        std::atomic<size_t> _enqueue_pos;
+        cache_line_pad _pad2;
+        std::atomic<size_t> _dequeue_pos;
+        cache_line_pad _pad3;
+        std::atomic<size_t> _overflow_size;
+        std::mutex _overflow_mutex;
+        std::deque<basic_task_ptr> _overflow;
+
+        lockfree_task_queue(const lockfree_task_queue&);
+        lockfree_task_queue& operator=(const lockfree_task_queue&);
+
+        bool pop_ring(basic_task_ptr& t) NOEXCEPT;
+
+    public:
+        static const size_t default_capacity;
+
+        /**
+         * @param capacity maximum amount of queued tasks,
+         * will be rounded up to a power of two
+         */
+        lockfree_task_queue(size_t capacity=default_capacity);
+        ~lockfree_task_queue();
+
+        size_t capacity() const NOEXCEPT;
+
+        /**
+         * Add a task at the end of the ring if there is space
+         * @return false if the ring was full
+         */
+        bool try_push(basic_task_ptr& t) NOEXCEPT;
+
+        using task_queue::push;
+
+        /**
+         * Add a task to the ring, or to the overflow list
+         * if the ring is full or the list still has tasks
+         */
+        void push(basic_task_ptr&& t) NOEXCEPT;
+        bool pop(basic_task_ptr& t) NOEXCEPT;
+    };
+
+}
+
+#endif
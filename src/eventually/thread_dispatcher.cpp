@@ -1,71 +1,715 @@
 
 #include <eventually/thread_dispatcher.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace eventually {
 
-    thread_dispatcher::thread_dispatcher(size_t thread_count):
-    _wait(duration::zero())
+    namespace {
+
+        /**
+         * Tell the cpu that this is a spin loop
+         */
+        inline void cpu_relax() NOEXCEPT
+        {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            __builtin_ia32_pause();
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__arm__))
+            __asm__ __volatile__("yield");
+#endif
+        }
+
+        const size_t spin_pauses = 16;
+
+        /**
+         * The worker that is running in the current thread
+         */
+        struct current_worker
+        {
+            thread_dispatcher* dispatcher;
+            size_t index;
+            size_t blocking;
+        };
+
+        thread_local current_worker current = { nullptr, 0, 0 };
+
+        typedef std::vector<int> cpu_list;
+
+        /**
+         * Parse a linux cpu list like 0-3,8,10-11
+         */
+        cpu_list parse_cpu_list(const std::string& str)
+        {
+            cpu_list cpus;
+            std::istringstream in(str);
+            std::string range;
+            while(std::getline(in, range, ','))
+            {
+                std::istringstream range_in(range);
+                int first = 0;
+                if(!(range_in >> first))
+                {
+                    continue;
+                }
+                int last = first;
+                char dash;
+                if(range_in >> dash)
+                {
+                    range_in >> last;
+                }
+                for(int cpu=first; cpu<=last; ++cpu)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        bool read_cpu_list(const std::string& path, cpu_list& cpus)
+        {
+            std::ifstream in(path);
+            std::string line;
+            if(!std::getline(in, line))
+            {
+                return false;
+            }
+            cpus = parse_cpu_list(line);
+            return true;
+        }
+
+        /**
+         * The cpus where the process can run, empty if unknown
+         */
+        cpu_list get_process_cpus()
+        {
+            cpu_list cpus;
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if(sched_getaffinity(0, sizeof(set), &set) == 0)
+            {
+                for(int cpu=0; cpu<CPU_SETSIZE; ++cpu)
+                {
+                    if(CPU_ISSET(cpu, &set))
+                    {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            return cpus;
+        }
+
+        /**
+         * Group the cpus by numa node,
+         * one group with all of them if the nodes are unknown
+         */
+        std::vector<cpu_list> get_numa_nodes(const cpu_list& cpus)
+        {
+            std::vector<cpu_list> nodes;
+            const std::string path = "/sys/devices/system/node/";
+            cpu_list ids;
+            if(read_cpu_list(path + "online", ids))
+            {
+                for(int id : ids)
+                {
+                    cpu_list node_cpus;
+                    if(!read_cpu_list(path + "node" + std::to_string(id) + "/cpulist", node_cpus))
+                    {
+                        continue;
+                    }
+                    cpu_list node;
+                    for(int cpu : node_cpus)
+                    {
+                        if(std::find(cpus.begin(), cpus.end(), cpu) != cpus.end())
+                        {
+                            node.push_back(cpu);
+                        }
+                    }
+                    if(!node.empty())
+                    {
+                        nodes.push_back(node);
+                    }
+                }
+            }
+            if(nodes.empty())
+            {
+                nodes.push_back(cpus);
+            }
+            return nodes;
+        }
+
+        /**
+         * Only run the current thread in a list of cpus
+         */
+        void set_thread_cpus(const cpu_list& cpus) NOEXCEPT
+        {
+#if defined(__linux__)
+            if(cpus.empty())
+            {
+                return;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for(int cpu : cpus)
+            {
+                if(cpu >= 0 && cpu < CPU_SETSIZE)
+                {
+                    CPU_SET(cpu, &set);
+                }
+            }
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+        }
+    }
+
+    thread_dispatcher_options::thread_dispatcher_options():
+    thread_count(std::thread::hardware_concurrency()),
+    wait(std::chrono::milliseconds::zero()),
+    queue(nullptr), work_stealing(false),
+    spin_count(default_spin_count),
+    min_thread_count(0), max_thread_count(0),
+    idle_timeout(default_idle_timeout),
+    grow_backlog(default_grow_backlog),
+    grow_wait(default_grow_wait),
+    max_blocking_thread_count(default_max_blocking_thread_count),
+    pin_threads(false), numa(false)
+    {
+    }
+
+    const size_t thread_dispatcher_options::default_spin_count = 100;
+    const size_t thread_dispatcher_options::default_grow_backlog = 64;
+    const size_t thread_dispatcher_options::default_max_blocking_thread_count = 0;
+    const std::chrono::milliseconds thread_dispatcher_options::default_idle_timeout(10000);
+    const std::chrono::milliseconds thread_dispatcher_options::default_grow_wait(10);
+
+    thread_dispatcher::thread_dispatcher(size_t thread_count)
+    {
+        options opts;
+        opts.thread_count = thread_count;
+        init(opts);
+    }
+
+    thread_dispatcher::thread_dispatcher(const duration& wait, size_t thread_count)
+    {
+        options opts;
+        opts.wait = wait;
+        opts.thread_count = thread_count;
+        init(opts);
+    }
+
+    thread_dispatcher::thread_dispatcher(task_queue* queue, size_t thread_count):
+    dispatcher(queue)
     {
-        init(thread_count);
+        options opts;
+        opts.thread_count = thread_count;
+        init(opts);
     }
 
-    thread_dispatcher::thread_dispatcher(const duration& wait, size_t thread_count):
-    _wait(wait)
+    thread_dispatcher::thread_dispatcher(const options& opts):
+    dispatcher(opts.queue)
     {
-        init(thread_count);
+        init(opts);
     }
 
-    void thread_dispatcher::init(size_t thread_count)
+    void thread_dispatcher::init(const options& opts)
     {
+        _wait = opts.wait;
+        _spin_count = opts.spin_count;
+        _min_threads = opts.min_thread_count ? opts.min_thread_count : opts.thread_count;
+        _max_threads = opts.max_thread_count ? opts.max_thread_count : opts.thread_count;
+        _max_threads = std::max(_min_threads, _max_threads);
+        _idle_timeout = opts.idle_timeout;
+        _grow_backlog = opts.grow_backlog;
+        _grow_wait = opts.grow_wait;
+        _on_resize = opts.on_resize;
+        _max_blocking_threads = opts.max_blocking_thread_count;
+        _blocking_count.store(0);
+        _thread_count.store(0);
+        _used_slots.store(0);
+        _last_idle.store(clock::now().time_since_epoch().count());
         _done.store(false);
+        // every thread slot has its deque, a new thread reuses the slot of a removed one
+        _workers.resize(_max_threads + _max_blocking_threads);
+        cpu_list cpus = opts.cpu_set.empty() ? get_process_cpus() : opts.cpu_set;
+        std::vector<cpu_list> nodes;
+        if(opts.numa)
+        {
+            nodes = get_numa_nodes(cpus);
+        }
+        else
+        {
+            nodes.push_back(cpus);
+        }
+        if(nodes.size() > 1)
+        {
+            for(size_t i=0; i<nodes.size(); ++i)
+            {
+                _node_queues.push_back(std::unique_ptr<task_queue>(new priority_task_queue()));
+            }
+        }
+        for(size_t i=0; i<_workers.size(); ++i)
+        {
+            // consecutive threads go to different nodes
+            auto& worker_ = _workers[i];
+            auto& node_cpus = nodes[i % nodes.size()];
+            worker_.running = false;
+            worker_.node = i % nodes.size();
+            if(opts.pin_threads && !node_cpus.empty())
+            {
+                worker_.cpus.push_back(node_cpus[(i / nodes.size()) % node_cpus.size()]);
+            }
+            else if(opts.numa || !opts.cpu_set.empty())
+            {
+                worker_.cpus = node_cpus;
+            }
+        }
+        if(opts.work_stealing)
+        {
+            for(size_t i=0; i<_workers.size(); ++i)
+            {
+                _deques.push_back(std::unique_ptr<work_stealing_deque>(
+                    new work_stealing_deque()));
+            }
+        }
+        size_t thread_count = std::min(std::max(opts.thread_count, _min_threads), _max_threads);
+        std::unique_lock<std::mutex> lock_(_workers_mutex);
         try
         {
             for(size_t i=0; i<thread_count; ++i)
             {
-                _threads.push_back(
-                    std::thread(&thread_dispatcher::worker_thread, this, i));
+                // counted before it starts so that it sees itself when idle
+                _workers[i].running = true;
+                _thread_count.fetch_add(1);
+                _used_slots.store(i + 1);
+                _workers[i].thread = std::thread(&thread_dispatcher::worker_thread, this, i);
             }
         }
         catch(...)
         {
             _done.store(true);
+            lock_.unlock();
+            _idle.notify_all();
+            for(auto& worker_ : _workers)
+            {
+                if(worker_.thread.joinable())
+                {
+                    worker_.thread.join();
+                }
+            }
             throw;
         }
     }
 
     thread_dispatcher::~thread_dispatcher()
     {
+        unlink();
+        _done.store(true);
+        _idle.notify_all();
+        std::vector<std::thread> threads;
         {
-            std::unique_lock<std::mutex> lock_(_wait_mutex);
-            _done.store(true);
-            _new_task.notify_all();
+            // threads that are being removed need the lock to finish
+            std::lock_guard<std::mutex> lock_(_workers_mutex);
+            for(auto& worker_ : _workers)
+            {
+                if(worker_.thread.joinable())
+                {
+                    threads.push_back(std::move(worker_.thread));
+                }
+            }
         }
-        for(auto& thread_ : _threads)
+        for(auto& thread_ : threads)
         {
             thread_.join();
         }
     }
 
+    bool thread_dispatcher::is_elastic() const NOEXCEPT
+    {
+        return _min_threads < _max_threads || _max_blocking_threads > 0;
+    }
+
+    size_t thread_dispatcher::get_blocking_threads() const NOEXCEPT
+    {
+        return std::min(_blocking_count.load(), _max_blocking_threads);
+    }
+
+    size_t thread_dispatcher::get_blocking_count() const NOEXCEPT
+    {
+        return _blocking_count.load();
+    }
+
+    void thread_dispatcher::begin_blocking() NOEXCEPT
+    {
+        _blocking_count.fetch_add(1);
+        if(_thread_count.load() < _max_threads + get_blocking_threads())
+        {
+            add_thread();
+        }
+    }
+
+    void thread_dispatcher::end_blocking() NOEXCEPT
+    {
+        // the extra thread leaves the pool when it is idle for idle_timeout
+        _blocking_count.fetch_sub(1);
+    }
+
+    size_t thread_dispatcher::get_thread_count() const NOEXCEPT
+    {
+        return _thread_count.load();
+    }
+
+    bool thread_dispatcher::should_grow() const NOEXCEPT
+    {
+        if(_thread_count.load() == 0)
+        {
+            return true;
+        }
+        if(_idle.get_waiters() > 0)
+        {
+            return false;
+        }
+        size_t backlog = get_queue_size();
+        if(backlog == 0)
+        {
+            return false;
+        }
+        if(backlog > _grow_backlog)
+        {
+            return true;
+        }
+        if(_grow_wait == duration::zero())
+        {
+            return false;
+        }
+        auto last_idle = clock::time_point(clock::duration(_last_idle.load()));
+        return clock::now() - last_idle >= _grow_wait;
+    }
+
+    bool thread_dispatcher::add_thread() NOEXCEPT
+    {
+        std::thread removed;
+        size_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock_(_workers_mutex);
+            if(_done.load() || _thread_count.load() >= _max_threads + get_blocking_threads())
+            {
+                return false;
+            }
+            size_t i = 0;
+            while(_workers[i].running)
+            {
+                ++i;
+            }
+            auto& worker_ = _workers[i];
+            if(worker_.thread.joinable())
+            {
+                removed = std::move(worker_.thread);
+            }
+            worker_.running = true;
+            count = _thread_count.fetch_add(1) + 1;
+            _used_slots.store(std::max(_used_slots.load(), i + 1));
+            try
+            {
+                worker_.thread = std::thread(&thread_dispatcher::worker_thread, this, i);
+            }
+            catch(...)
+            {
+                worker_.running = false;
+                _thread_count.fetch_sub(1);
+                return false;
+            }
+        }
+        if(removed.joinable())
+        {
+            removed.join();
+        }
+        if(_on_resize)
+        {
+            _on_resize(count);
+        }
+        return true;
+    }
+
+    bool thread_dispatcher::remove_thread(size_t i) NOEXCEPT
+    {
+        size_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock_(_workers_mutex);
+            if(_done.load() || _thread_count.load() <= _min_threads + get_blocking_threads())
+            {
+                return false;
+            }
+            if(!_deques.empty() && !_deques[i]->empty())
+            {
+                return false;
+            }
+            count = _thread_count.fetch_sub(1) - 1;
+            // tasks pushed before the count changed did not add a thread,
+            // and the last thread can not leave timers or waiting tasks behind
+            if(get_queue_size() > 0 || (count == 0 &&
+                (has_waiting_tasks() || get_next_timer() != clock::time_point::max())))
+            {
+                _thread_count.fetch_add(1);
+                return false;
+            }
+            _workers[i].running = false;
+        }
+        if(_on_resize)
+        {
+            _on_resize(count);
+        }
+        return true;
+    }
+
+    void thread_dispatcher::push_task(basic_task_ptr&& t) NOEXCEPT
+    {
+        if(!_deques.empty() && current.dispatcher == this)
+        {
+            // dispatched from one of our workers, keep it local
+            record_push(*t);
+            _deques[current.index]->push(std::move(t));
+            notify_tasks(1);
+            return;
+        }
+        if(!_node_queues.empty() && current.dispatcher == this)
+        {
+            record_push(*t);
+            _node_queues[_workers[current.index].node]->push(std::move(t));
+            notify_tasks(1);
+            return;
+        }
+        dispatcher::push_task(std::move(t));
+    }
+
+    void thread_dispatcher::push_tasks(std::vector<basic_task_ptr>&& ts) NOEXCEPT
+    {
+        if(!_deques.empty() && current.dispatcher == this)
+        {
+            size_t count = ts.size();
+            for(auto& t : ts)
+            {
+                record_push(*t);
+                _deques[current.index]->push(std::move(t));
+            }
+            ts.clear();
+            notify_tasks(count);
+            return;
+        }
+        if(!_node_queues.empty() && current.dispatcher == this && !ts.empty())
+        {
+            size_t count = ts.size();
+            for(auto& t : ts)
+            {
+                record_push(*t);
+            }
+            _node_queues[_workers[current.index].node]->push(std::move(ts));
+            notify_tasks(count);
+            return;
+        }
+        dispatcher::push_tasks(std::move(ts));
+    }
+
+    void thread_dispatcher::purge_tasks(std::vector<basic_task_ptr>& purged) NOEXCEPT
+    {
+        dispatcher::purge_tasks(purged);
+        for(auto& queue : _node_queues)
+        {
+            queue->purge(purged);
+        }
+    }
+
+    void thread_dispatcher::notify_tasks(size_t count) NOEXCEPT
+    {
+        _idle.notify(count);
+        if(_thread_count.load() < _max_threads + get_blocking_threads() && should_grow())
+        {
+            add_thread();
+        }
+    }
+
+    bool thread_dispatcher::process_worker(size_t i) NOEXCEPT
+    {
+        if(_deques.empty() && _node_queues.empty())
+        {
+            return process_next();
+        }
+        basic_task_ptr task_;
+        // the owner takes its newest task, the thieves the oldest ones
+        if(!_deques.empty() && _deques[i]->pop(task_))
+        {
+            return process_task(std::move(task_));
+        }
+        size_t node = _workers[i].node;
+        if(!_node_queues.empty() && _node_queues[node]->pop(task_))
+        {
+            return process_task(std::move(task_));
+        }
+        if(process_next())
+        {
+            return true;
+        }
+        for(size_t j=1; j<_node_queues.size(); ++j)
+        {
+            if(_node_queues[(node+j)%_node_queues.size()]->pop(task_))
+            {
+                return process_task(std::move(task_));
+            }
+        }
+        if(_deques.empty())
+        {
+            return false;
+        }
+        // only the slots that had a thread can have tasks
+        size_t n = _used_slots.load();
+        for(size_t j=1; j<n; ++j)
+        {
+            if(_deques[(i+j)%n]->steal(task_))
+            {
+                return process_task(std::move(task_));
+            }
+        }
+        return false;
+    }
+
+    bool thread_dispatcher::process_one() NOEXCEPT
+    {
+        if(current.dispatcher == this)
+        {
+            return process_worker(current.index);
+        }
+        if(dispatcher::process_one())
+        {
+            return true;
+        }
+        basic_task_ptr task_;
+        for(auto& queue : _node_queues)
+        {
+            if(queue->pop(task_))
+            {
+                process_task(std::move(task_));
+                return true;
+            }
+        }
+        size_t n = std::min(_used_slots.load(), _deques.size());
+        for(size_t i=0; i<n; ++i)
+        {
+            if(_deques[i]->steal(task_))
+            {
+                process_task(std::move(task_));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    thread_dispatcher::clock::time_point thread_dispatcher::get_idle_deadline() const NOEXCEPT
+    {
+        auto deadline = get_next_timer();
+        if(has_waiting_tasks())
+        {
+            deadline = std::min(deadline, clock::now() + get_retry_interval());
+        }
+        return deadline;
+    }
+
     void thread_dispatcher::worker_thread(size_t i)
     {
+        current.dispatcher = this;
+        current.index = i;
+        set_thread_cpus(_workers[i].cpus);
+        size_t spins = 0;
+        bool idle = false;
+        clock::time_point idle_start;
         while(!_done.load())
         {
-            while(process_one())
+            if(process_worker(i))
             {
-                if(_wait == duration::zero())
+                spins = 0;
+                idle = false;
+                if(_wait != duration::zero())
                 {
-                    std::this_thread::yield();
+                    std::this_thread::sleep_for(_wait);
                 }
-                else
+                continue;
+            }
+            if(!idle && is_elastic())
+            {
+                idle = true;
+                idle_start = clock::now();
+                _last_idle.store(idle_start.time_since_epoch().count());
+            }
+            if(spins < _spin_count)
+            {
+                // new tasks usually come soon, do not go to sleep yet
+                ++spins;
+                for(size_t j=0; j<spin_pauses; ++j)
                 {
-                    std::this_thread::sleep_for(_wait);
+                    cpu_relax();
+                }
+                continue;
+            }
+            spins = 0;
+            if(idle)
+            {
+                auto now = clock::now();
+                _last_idle.store(now.time_since_epoch().count());
+                if(now - idle_start >= _idle_timeout)
+                {
+                    if(remove_thread(i))
+                    {
+                        return;
+                    }
+                    // the pool could not shrink, check again after another timeout
+                    idle_start = now;
                 }
             }
-            std::unique_lock<std::mutex> lock_(_wait_mutex);
-            if(!_done)
+            auto key = _idle.prepare_wait();
+            // a task pushed before prepare_wait did not wake anyone
+            if(_done.load() || process_worker(i))
+            {
+                _idle.cancel_wait();
+                idle = false;
+                continue;
+            }
+            auto deadline = get_idle_deadline();
+            if(idle && _idle_timeout > duration::zero())
             {
-                _new_task.wait(lock_);
+                // the thread count can change while sleeping, so always
+                // wake up to check if this thread can leave the pool
+                deadline = std::min(deadline, idle_start + _idle_timeout);
             }
+            _idle.commit_wait(key, deadline);
+        }
+    }
+
+    blocking_scope::blocking_scope() NOEXCEPT:
+    _dispatcher(nullptr)
+    {
+        // nested scopes count once
+        if(current.dispatcher && current.blocking++ == 0)
+        {
+            _dispatcher = current.dispatcher;
+            _dispatcher->begin_blocking();
+        }
+    }
+
+    blocking_scope::~blocking_scope() NOEXCEPT
+    {
+        if(current.dispatcher)
+        {
+            --current.blocking;
+        }
+        if(_dispatcher)
+        {
+            _dispatcher->end_blocking();
         }
     }
 
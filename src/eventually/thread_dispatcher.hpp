@@ -1,9 +1,14 @@
-
 #ifndef _eventually_thread_dispatcher_hpp_
 #define _eventually_thread_dispatcher_hpp_
 
 #include <eventually/dispatcher.hpp>
+#include <eventually/eventcount.hpp>
+#include <eventually/work_stealing_deque.hpp>
+#include <eventually/task_queue.hpp>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <thread>
 #include <atomic>
@@ -11,25 +16,222 @@
 namespace eventually {
 
     /**
-     * Calls dispatcher process on a set of threads
+     * Construction options for a thread_dispatcher
+     */
+    struct thread_dispatcher_options
+    {
+        /**
+         * amount of threads processing tasks
+         * (by default std::thread::hardware_concurrency())
+         */
+        size_t thread_count;
+
+        /**
+         * time to wait between tasks, zero does not wait
+         */
+        std::chrono::milliseconds wait;
+
+        /**
+         * queue where the tasks are stored, the dispatcher takes ownership.
+         * If null a priority_task_queue is used.
+         */
+        task_queue* queue;
+
+        /**
+         * give every thread its own work_stealing_deque. Tasks dispatched
+         * from inside a worker thread go to its deque, the worker runs
+         * the newest one first and idle workers steal the oldest ones.
+         */
+        bool work_stealing;
+
+        /**
+         * times an idle thread checks for new tasks
+         * before going to sleep
+         */
+        size_t spin_count;
+
+        /**
+         * limits of the amount of threads, zero means thread_count.
+         * If they are different the pool is elastic and thread_count
+         * is the amount of threads that it starts with.
+         */
+        size_t min_thread_count;
+        size_t max_thread_count;
+
+        /**
+         * time after which an idle thread leaves an elastic pool
+         */
+        std::chrono::milliseconds idle_timeout;
+
+        /**
+         * an elastic pool adds a thread when tasks are dispatched while
+         * no thread is sleeping and there are more than grow_backlog
+         * tasks in the queue or no thread was idle during grow_wait
+         */
+        size_t grow_backlog;
+        std::chrono::milliseconds grow_wait;
+
+        /**
+         * called with the new amount of threads when an elastic pool
+         * grows or shrinks, from the thread that changed it
+         */
+        std::function<void(size_t)> on_resize;
+
+        /**
+         * extra threads over max_thread_count that the pool can add
+         * to compensate for threads blocked inside a blocking_scope,
+         * zero by default so the pool only grows if asked to
+         */
+        size_t max_blocking_thread_count;
+
+        /**
+         * cpus where the threads run,
+         * if empty all the cpus where the process can run
+         */
+        std::vector<int> cpu_set;
+
+        /**
+         * pin every thread to one cpu of the cpu set
+         * so that the threads do not migrate
+         */
+        bool pin_threads;
+
+        /**
+         * spread the threads over the numa nodes of the cpu set, a thread
+         * only runs in the cpus of its node. Every node has its own queue
+         * where the tasks dispatched from the threads of the node go.
+         */
+        bool numa;
+
+        static const size_t default_spin_count;
+        static const size_t default_grow_backlog;
+        static const size_t default_max_blocking_thread_count;
+        static const std::chrono::milliseconds default_idle_timeout;
+        static const std::chrono::milliseconds default_grow_wait;
+
+        thread_dispatcher_options();
+    };
+
+    class blocking_scope;
+
+    /**
+     * Calls dispatcher process on a set of threads.
+     * Idle threads spin for a while and then sleep on an eventcount
+     * until there are new tasks or the next timer is due.
+     * The amount of threads can change between a minimum and a maximum.
      */
     class thread_dispatcher : public dispatcher
     {
 
     public:
         typedef std::chrono::milliseconds duration;
+        typedef thread_dispatcher_options options;
     private:
+        struct worker
+        {
+            std::thread thread;
+            bool running;
+            size_t node;
+            std::vector<int> cpus;
+        };
+
         duration _wait;
-        std::vector<std::thread> _threads;
+        size_t _spin_count;
+        size_t _min_threads;
+        size_t _max_threads;
+        duration _idle_timeout;
+        size_t _grow_backlog;
+        duration _grow_wait;
+        std::function<void(size_t)> _on_resize;
+        size_t _max_blocking_threads;
+        std::atomic<size_t> _blocking_count;
+        std::mutex _workers_mutex;
+        std::vector<worker> _workers;
+        std::atomic<size_t> _thread_count;
+        std::atomic<size_t> _used_slots;
+        std::atomic<clock::rep> _last_idle;
+        std::vector<std::unique_ptr<work_stealing_deque>> _deques;
+        std::vector<std::unique_ptr<task_queue>> _node_queues;
         std::atomic_bool _done;
-        std::mutex _wait_mutex;
+        eventcount _idle;
 
         void worker_thread(size_t i);
-        void init(size_t thread_count);
+        clock::time_point get_idle_deadline() const NOEXCEPT;
+        bool process_worker(size_t i) NOEXCEPT;
+        void init(const options& opts);
+        bool is_elastic() const NOEXCEPT;
+        bool should_grow() const NOEXCEPT;
+        bool add_thread() NOEXCEPT;
+        bool remove_thread(size_t i) NOEXCEPT;
+        size_t get_blocking_threads() const NOEXCEPT;
+        void begin_blocking() NOEXCEPT;
+        void end_blocking() NOEXCEPT;
+
+        friend class blocking_scope;
+
+    protected:
+        void push_task(basic_task_ptr&& t) NOEXCEPT;
+        void push_tasks(std::vector<basic_task_ptr>&& ts) NOEXCEPT;
+
+        /**
+         * Wake up one sleeping thread per task,
+         * an elastic pool may add a thread
+         */
+        void notify_tasks(size_t count) NOEXCEPT;
+
+        /**
+         * Also purge the numa node queues, the tasks in the
+         * worker deques are only taken by their threads
+         */
+        void purge_tasks(std::vector<basic_task_ptr>& purged) NOEXCEPT;
+
     public:
         thread_dispatcher(size_t thread_count);
         thread_dispatcher(const duration& wait=duration::zero(), size_t thread_count=std::thread::hardware_concurrency());
+
+        /**
+         * @param queue where the tasks are stored, the dispatcher takes ownership
+         * @param thread_count amount of threads processing the queue
+         */
+        thread_dispatcher(task_queue* queue, size_t thread_count=std::thread::hardware_concurrency());
+
+        thread_dispatcher(const options& opts);
         ~thread_dispatcher();
+
+        /**
+         * Process a task from the queue or from the worker deques,
+         * used by threads that wait for the dispatcher to finish some work
+         */
+        bool process_one() NOEXCEPT;
+
+        /**
+         * Amount of threads that are processing tasks
+         */
+        size_t get_thread_count() const NOEXCEPT;
+
+        /**
+         * Amount of threads inside a blocking_scope
+         */
+        size_t get_blocking_count() const NOEXCEPT;
+    };
+
+    /**
+     * Marks a part of a task that blocks, for example waiting for io.
+     * Inside a thread_dispatcher thread the pool adds another thread
+     * while the scope exists so that the other tasks keep running.
+     * In other threads it does nothing.
+     */
+    class blocking_scope
+    {
+    private:
+        thread_dispatcher* _dispatcher;
+
+        blocking_scope(const blocking_scope&);
+        blocking_scope& operator=(const blocking_scope&);
+
+    public:
+        blocking_scope() NOEXCEPT;
+        ~blocking_scope() NOEXCEPT;
     };
 
 }
@@ -0,0 +1,196 @@
+
+#include <eventually/timer_wheel.hpp>
+
+namespace eventually {
+
+    namespace {
+
+        const uint64_t slot_mask = timer_wheel::slot_count - 1;
+
+        size_t count_trailing_zeros(uint64_t v) NOEXCEPT
+        {
+#if defined(__GNUC__)
+            return __builtin_ctzll(v);
+#else
+            size_t n = 0;
+            while((v & 1) == 0)
+            {
+                v >>= 1;
+                ++n;
+            }
+            return n;
+#endif
+        }
+
+        uint64_t rotate_right(uint64_t v, size_t n) NOEXCEPT
+        {
+            n &= 63;
+            return n == 0 ? v : (v >> n) | (v << (64 - n));
+        }
+    }
+
+    timer_wheel::timer_wheel(tick now):
+    _now(now), _size(0)
+    {
+        for(size_t k=0; k<level_count; ++k)
+        {
+            _used[k] = 0;
+        }
+    }
+
+    void timer_wheel::insert(timer&& t, std::vector<basic_task_ptr>& expired)
+    {
+        if(t.time <= _now)
+        {
+            expired.push_back(std::move(t.task));
+            --_size;
+            return;
+        }
+        tick delta = t.time - _now;
+        size_t level = 0;
+        while(level < level_count - 1 && delta >= ((tick)1 << (slot_bits * (level + 1))))
+        {
+            ++level;
+        }
+        // timers further than the top level are moved again when their slot is reached
+        size_t i = (t.time >> (slot_bits * level)) & slot_mask;
+        _slots[level][i].push_back(std::move(t));
+        _used[level] |= (uint64_t)1 << i;
+    }
+
+    bool timer_wheel::next_slot(size_t level, tick& t) const NOEXCEPT
+    {
+        uint64_t used = _used[level];
+        if(used == 0)
+        {
+            return false;
+        }
+        size_t shift = slot_bits * level;
+        tick current = _now >> shift;
+        // distance from the slot after the current one
+        uint64_t rotated = rotate_right(used, (current + 1) & slot_mask);
+        tick distance = count_trailing_zeros(rotated) + 1;
+        t = (current + distance) << shift;
+        return true;
+    }
+
+    void timer_wheel::add(tick time, basic_task_ptr&& task)
+    {
+        timer t;
+        t.time = time > _now ? time : _now + 1;
+        t.task = std::move(task);
+        ++_size;
+        std::vector<basic_task_ptr> expired;
+        insert(std::move(t), expired);
+    }
+
+    void timer_wheel::advance(tick now, std::vector<basic_task_ptr>& expired)
+    {
+        tick t = _now;
+        while(next(t) && t <= now)
+        {
+            _now = t;
+            // move the timers of the higher level slots that start now
+            for(size_t k=level_count-1; k>0; --k)
+            {
+                size_t shift = slot_bits * k;
+                if((t & (((tick)1 << shift) - 1)) != 0)
+                {
+                    continue;
+                }
+                size_t i = (t >> shift) & slot_mask;
+                if(_used[k] & ((uint64_t)1 << i))
+                {
+                    slot timers;
+                    timers.swap(_slots[k][i]);
+                    _used[k] &= ~((uint64_t)1 << i);
+                    for(auto& timer_ : timers)
+                    {
+                        insert(std::move(timer_), expired);
+                    }
+                }
+            }
+            size_t i = t & slot_mask;
+            if(_used[0] & ((uint64_t)1 << i))
+            {
+                for(auto& timer_ : _slots[0][i])
+                {
+                    expired.push_back(std::move(timer_.task));
+                    --_size;
+                }
+                _slots[0][i].clear();
+                _used[0] &= ~((uint64_t)1 << i);
+            }
+        }
+        if(now > _now)
+        {
+            _now = now;
+        }
+    }
+
+    size_t timer_wheel::purge(std::vector<basic_task_ptr>& purged)
+    {
+        size_t count = 0;
+        for(size_t k=0; k<level_count; ++k)
+        {
+            uint64_t used = _used[k];
+            while(used != 0)
+            {
+                size_t i = count_trailing_zeros(used);
+                used &= used - 1;
+                auto& timers = _slots[k][i];
+                auto last = timers.begin();
+                for(auto itr = timers.begin(); itr != timers.end(); ++itr)
+                {
+                    if(itr->task->interrupted())
+                    {
+                        purged.push_back(std::move(itr->task));
+                        ++count;
+                    }
+                    else
+                    {
+                        *last++ = std::move(*itr);
+                    }
+                }
+                timers.erase(last, timers.end());
+                if(timers.empty())
+                {
+                    _used[k] &= ~((uint64_t)1 << i);
+                }
+            }
+        }
+        _size -= count;
+        return count;
+    }
+
+    bool timer_wheel::next(tick& t) const NOEXCEPT
+    {
+        bool found = false;
+        for(size_t k=0; k<level_count; ++k)
+        {
+            tick slot_ = 0;
+            if(next_slot(k, slot_) && (!found || slot_ < t))
+            {
+                t = slot_;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    timer_wheel::tick timer_wheel::now() const NOEXCEPT
+    {
+        return _now;
+    }
+
+    size_t timer_wheel::size() const NOEXCEPT
+    {
+        return _size;
+    }
+
+    bool timer_wheel::empty() const NOEXCEPT
+    {
+        return _size == 0;
+    }
+
+}
@@ -0,0 +1,82 @@
+#ifndef _eventually_timer_wheel_hpp_
+#define _eventually_timer_wheel_hpp_
+
+#include <eventually/define.hpp>
+#include <eventually/task.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace eventually {
+
+    /**
+     * A hierarchical timer wheel that stores tasks until a tick.
+     * Every level has 64 slots, a slot of level k covers 64^k ticks.
+     * Tasks are added to the level where their distance fits and moved
+     * to the lower levels when the wheel reaches their slot, so adding
+     * is constant time and advancing only visits the non empty slots.
+     * It is not thread safe.
+     */
+    class timer_wheel
+    {
+    public:
+        typedef uint64_t tick;
+
+        static const size_t slot_bits = 6;
+        static const size_t slot_count = 1 << slot_bits;
+        static const size_t level_count = 6;
+
+    private:
+        struct timer
+        {
+            tick time;
+            basic_task_ptr task;
+        };
+
+        typedef std::vector<timer> slot;
+
+        slot _slots[level_count][slot_count];
+        uint64_t _used[level_count];
+        tick _now;
+        size_t _size;
+
+        timer_wheel(const timer_wheel&);
+        timer_wheel& operator=(const timer_wheel&);
+
+        void insert(timer&& t, std::vector<basic_task_ptr>& expired);
+        bool next_slot(size_t level, tick& t) const NOEXCEPT;
+
+    public:
+        timer_wheel(tick now=0);
+
+        /**
+         * Add a task that expires when the wheel reaches a tick,
+         * the ticks that already passed expire in the next advance
+         */
+        void add(tick time, basic_task_ptr&& task);
+
+        /**
+         * Move the wheel to a tick
+         * @param expired where the expired tasks are added in tick order
+         */
+        void advance(tick now, std::vector<basic_task_ptr>& expired);
+
+        /**
+         * Remove the tasks whose connection was interrupted
+         * @return the amount of tasks added to purged
+         */
+        size_t purge(std::vector<basic_task_ptr>& purged);
+
+        /**
+         * Get the next tick where advance will do something
+         * @return false if the wheel is empty
+         */
+        bool next(tick& t) const NOEXCEPT;
+
+        tick now() const NOEXCEPT;
+        size_t size() const NOEXCEPT;
+        bool empty() const NOEXCEPT;
+    };
+
+}
+
+#endif
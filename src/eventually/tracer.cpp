@@ -0,0 +1,269 @@
+
+#include <eventually/tracer.hpp>
+#include <algorithm>
+#include <cstdio>
+
+namespace eventually {
+
+    namespace {
+
+        std::atomic<uint64_t> next_tracer(1);
+
+        /**
+         * The buffer that the current thread used last
+         */
+        struct thread_buffer
+        {
+            uint64_t tracer_id;
+            void* buffer;
+        };
+
+        thread_local thread_buffer current_buffer = { 0, nullptr };
+        thread_local uint64_t current_task = 0;
+        thread_local const char* current_label = nullptr;
+
+        const char* default_label = "task";
+
+        void write_string(std::ostream& out, const char* str)
+        {
+            out << '"';
+            for(const char* c = str; *c; ++c)
+            {
+                switch(*c)
+                {
+                case '"':
+                    out << "\\\"";
+                    break;
+                case '\\':
+                    out << "\\\\";
+                    break;
+                default:
+                    if((unsigned char)*c < 0x20)
+                    {
+                        char code[8];
+                        snprintf(code, sizeof(code), "\\u%04x", (unsigned)*c);
+                        out << code;
+                    }
+                    else
+                    {
+                        out << *c;
+                    }
+                    break;
+                }
+            }
+            out << '"';
+        }
+
+        void write_time(std::ostream& out, int64_t ns)
+        {
+            // chrome traces use microseconds
+            char time[32];
+            snprintf(time, sizeof(time), "%lld.%03lld", (long long)(ns / 1000), (long long)(ns % 1000));
+            out << time;
+        }
+    }
+
+    const size_t tracer::default_capacity = 1 << 16;
+
+    task_trace::task_trace():
+    id(0), parent(0), label(nullptr)
+    {
+    }
+
+    tracer::tracer(size_t capacity):
+    _tracer_id(next_tracer.fetch_add(1)),
+    _capacity(2), _start(clock::now())
+    {
+        while(_capacity < capacity)
+        {
+            _capacity <<= 1;
+        }
+        _next_task.store(1);
+    }
+
+    tracer::buffer& tracer::get_buffer()
+    {
+        if(current_buffer.tracer_id == _tracer_id)
+        {
+            return *static_cast<buffer*>(current_buffer.buffer);
+        }
+        std::lock_guard<std::mutex> lock_(_buffers_mutex);
+        auto thread = std::this_thread::get_id();
+        buffer* found = nullptr;
+        for(auto& buffer_ : _buffers)
+        {
+            if(buffer_->thread == thread)
+            {
+                found = buffer_.get();
+                break;
+            }
+        }
+        if(!found)
+        {
+            std::unique_ptr<buffer> buffer_(new buffer());
+            buffer_->thread = thread;
+            buffer_->index = _buffers.size() + 1;
+            buffer_->events.reset(new event[_capacity]);
+            buffer_->head.store(0);
+            found = buffer_.get();
+            _buffers.push_back(std::move(buffer_));
+        }
+        current_buffer.tracer_id = _tracer_id;
+        current_buffer.buffer = found;
+        return *found;
+    }
+
+    int64_t tracer::get_time(const clock::time_point& time) const NOEXCEPT
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time - _start).count();
+    }
+
+    void tracer::record(event_type type, const task_trace& t, const clock::time_point& begin, const clock::time_point& end) NOEXCEPT
+    {
+        buffer* buffer_ = nullptr;
+        try
+        {
+            buffer_ = &get_buffer();
+        }
+        catch(...)
+        {
+            return;
+        }
+        // only this thread writes to the buffer
+        uint64_t head = buffer_->head.load(std::memory_order_relaxed);
+        event& e = buffer_->events[head & (_capacity - 1)];
+        e.type = type;
+        e.id = t.id;
+        e.parent = t.parent;
+        e.label = t.label ? t.label : default_label;
+        e.begin = get_time(begin);
+        e.end = get_time(end);
+        buffer_->head.store(head + 1, std::memory_order_release);
+    }
+
+    void tracer::push(task_trace& t) NOEXCEPT
+    {
+        t.id = _next_task.fetch_add(1, std::memory_order_relaxed);
+        t.parent = current_task;
+        if(t.parent != 0)
+        {
+            auto now = clock::now();
+            record(event_type::push, t, now, now);
+        }
+    }
+
+    void tracer::write_json(std::ostream& out) const
+    {
+        std::vector<buffer*> buffers;
+        {
+            std::lock_guard<std::mutex> lock_(_buffers_mutex);
+            for(auto& buffer_ : _buffers)
+            {
+                buffers.push_back(buffer_.get());
+            }
+        }
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        std::vector<event> events;
+        for(auto buffer_ : buffers)
+        {
+            uint64_t head = buffer_->head.load(std::memory_order_acquire);
+            uint64_t tail = head > _capacity ? head - _capacity : 0;
+            events.clear();
+            for(uint64_t i=tail; i<head; ++i)
+            {
+                events.push_back(buffer_->events[i & (_capacity - 1)]);
+            }
+            // the writer may have overwritten the oldest events while copying
+            uint64_t last = buffer_->head.load(std::memory_order_acquire);
+            size_t skip = last > tail + _capacity ? std::min<uint64_t>(last - tail - _capacity, events.size()) : 0;
+
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                << buffer_->index << ",\"args\":{\"name\":\"thread " << buffer_->index << "\"}}";
+            first = false;
+            for(size_t i=skip; i<events.size(); ++i)
+            {
+                const event& e = events[i];
+                if(e.type == event_type::push)
+                {
+                    out << ",\n{\"name\":\"continuation\",\"cat\":\"task\",\"ph\":\"s\",\"id\":" << e.id
+                        << ",\"ts\":";
+                    write_time(out, e.begin);
+                    out << ",\"pid\":1,\"tid\":" << buffer_->index << "}";
+                    continue;
+                }
+                out << ",\n{\"name\":";
+                write_string(out, e.label);
+                out << ",\"cat\":\"task\",\"ph\":\"X\",\"ts\":";
+                write_time(out, e.begin);
+                out << ",\"dur\":";
+                write_time(out, e.end - e.begin);
+                out << ",\"pid\":1,\"tid\":" << buffer_->index
+                    << ",\"args\":{\"id\":" << e.id << ",\"parent\":" << e.parent
+                    << ",\"ready\":" << (e.type == event_type::run ? "true" : "false") << "}}";
+                if(e.type == event_type::run && e.parent != 0)
+                {
+                    out << ",\n{\"name\":\"continuation\",\"cat\":\"task\",\"ph\":\"f\",\"bp\":\"e\",\"id\":" << e.id
+                        << ",\"ts\":";
+                    write_time(out, e.begin);
+                    out << ",\"pid\":1,\"tid\":" << buffer_->index << "}";
+                }
+            }
+        }
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    size_t tracer::get_event_count() const NOEXCEPT
+    {
+        std::lock_guard<std::mutex> lock_(_buffers_mutex);
+        size_t count = 0;
+        for(auto& buffer_ : _buffers)
+        {
+            count += std::min<uint64_t>(buffer_->head.load(), _capacity);
+        }
+        return count;
+    }
+
+    tracer::run_scope::run_scope(tracer* t, const task_trace& trace) NOEXCEPT:
+    _tracer(t), _trace(trace), _previous(current_task)
+    {
+        if(_tracer)
+        {
+            current_task = _trace.id;
+            _begin = clock::now();
+        }
+    }
+
+    tracer::run_scope::~run_scope() NOEXCEPT
+    {
+        if(_tracer)
+        {
+            current_task = _previous;
+        }
+    }
+
+    void tracer::run_scope::end(bool ready) NOEXCEPT
+    {
+        if(_tracer)
+        {
+            _tracer->record(ready ? event_type::run : event_type::not_ready, _trace, _begin, clock::now());
+        }
+    }
+
+    trace_label::trace_label(const char* label) NOEXCEPT:
+    _previous(current_label)
+    {
+        current_label = label;
+    }
+
+    trace_label::~trace_label() NOEXCEPT
+    {
+        current_label = _previous;
+    }
+
+    const char* trace_label::get_current() NOEXCEPT
+    {
+        return current_label;
+    }
+
+}
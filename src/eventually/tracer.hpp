@@ -0,0 +1,151 @@
+#ifndef _eventually_tracer_hpp_
+#define _eventually_tracer_hpp_
+
+#include <eventually/define.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace eventually {
+
+    /**
+     * What a tracer knows about a task
+     */
+    struct task_trace
+    {
+        uint64_t id;
+        uint64_t parent;
+        const char* label;
+
+        task_trace();
+    };
+
+    /**
+     * Records when the tasks of a dispatcher run in a lock free ring buffer
+     * per thread and writes them as chrome trace json, that can be opened
+     * in chrome://tracing or perfetto. A task pushed while another one runs
+     * in the same thread, like the continuations of a future, is linked to it.
+     * The dispatchers only record if the library is built with EVENTUALLY_TRACE.
+     */
+    class tracer
+    {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+        static const size_t default_capacity;
+
+        /**
+         * Marks the task that runs in the current thread
+         * while it exists, and records it when it ends
+         */
+        class run_scope
+        {
+        private:
+            tracer* _tracer;
+            const task_trace& _trace;
+            uint64_t _previous;
+            clock::time_point _begin;
+
+            run_scope(const run_scope&);
+            run_scope& operator=(const run_scope&);
+
+        public:
+            run_scope(tracer* t, const task_trace& trace) NOEXCEPT;
+            ~run_scope() NOEXCEPT;
+
+            void end(bool ready) NOEXCEPT;
+        };
+
+    private:
+        enum class event_type : uint8_t
+        {
+            push,
+            run,
+            not_ready
+        };
+
+        struct event
+        {
+            event_type type;
+            uint64_t id;
+            uint64_t parent;
+            const char* label;
+            int64_t begin;
+            int64_t end;
+        };
+
+        struct buffer
+        {
+            std::thread::id thread;
+            size_t index;
+            std::unique_ptr<event[]> events;
+            std::atomic<uint64_t> head;
+        };
+
+        uint64_t _tracer_id;
+        size_t _capacity;
+        clock::time_point _start;
+        std::atomic<uint64_t> _next_task;
+        mutable std::mutex _buffers_mutex;
+        std::vector<std::unique_ptr<buffer>> _buffers;
+
+        tracer(const tracer&);
+        tracer& operator=(const tracer&);
+
+        buffer& get_buffer();
+        void record(event_type type, const task_trace& t, const clock::time_point& begin, const clock::time_point& end) NOEXCEPT;
+        int64_t get_time(const clock::time_point& time) const NOEXCEPT;
+
+    public:
+        /**
+         * @param capacity events kept per thread, the oldest are overwritten
+         */
+        tracer(size_t capacity=default_capacity);
+
+        /**
+         * Give an id to a task that is added to a queue,
+         * linking it to the task that runs in the current thread.
+         * The label is set by whoever creates the trace.
+         */
+        void push(task_trace& t) NOEXCEPT;
+
+        /**
+         * Write the recorded events as chrome trace json.
+         * Events that are overwritten while writing are skipped.
+         */
+        void write_json(std::ostream& out) const;
+
+        /**
+         * Amount of events that are kept in the buffers
+         */
+        size_t get_event_count() const NOEXCEPT;
+    };
+
+    /**
+     * Sets the label of the tasks created in
+     * the current thread while it exists.
+     * The label has to live as long as the tracer, like a string literal.
+     */
+    class trace_label
+    {
+    private:
+        const char* _previous;
+
+        trace_label(const trace_label&);
+        trace_label& operator=(const trace_label&);
+
+    public:
+        trace_label(const char* label) NOEXCEPT;
+        ~trace_label() NOEXCEPT;
+
+        static const char* get_current() NOEXCEPT;
+    };
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+
+#include <eventually/work_stealing_deque.hpp>
+
+namespace eventually {
+
+    const size_t work_stealing_deque::default_capacity = 256;
+
+    work_stealing_deque::buffer::buffer(int64_t size):
+    size(size), tasks(new std::atomic<basic_task*>[size])
+    {
+    }
+
+    basic_task* work_stealing_deque::buffer::get(int64_t i) const NOEXCEPT
+    {
+        return tasks[i & (size - 1)].load(std::memory_order_relaxed);
+    }
+
+    void work_stealing_deque::buffer::put(int64_t i, basic_task* t) NOEXCEPT
+    {
+        tasks[i & (size - 1)].store(t, std::memory_order_relaxed);
+    }
+
+    work_stealing_deque::work_stealing_deque(size_t capacity)
+    {
+        int64_t size = 2;
+        while(size < (int64_t)capacity)
+        {
+            size <<= 1;
+        }
+        _buffers.push_back(std::unique_ptr<buffer>(new buffer(size)));
+        _buffer.store(_buffers.back().get(), std::memory_order_relaxed);
+        _top.store(0, std::memory_order_relaxed);
+        _bottom.store(0, std::memory_order_relaxed);
+    }
+
+    work_stealing_deque::~work_stealing_deque()
+    {
+        basic_task_ptr t;
+        while(pop(t))
+        {
+            t.reset();
+        }
+    }
+
+    work_stealing_deque::buffer* work_stealing_deque::grow(buffer* b, int64_t bottom, int64_t top)
+    {
+        std::unique_ptr<buffer> nb(new buffer(b->size * 2));
+        for(int64_t i=top; i<bottom; ++i)
+        {
+            nb->put(i, b->get(i));
+        }
+        _buffers.push_back(std::move(nb));
+        buffer* result = _buffers.back().get();
+        _buffer.store(result, std::memory_order_release);
+        return result;
+    }
+
+    void work_stealing_deque::push(basic_task_ptr&& t)
+    {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t tp = _top.load(std::memory_order_acquire);
+        buffer* a = _buffer.load(std::memory_order_relaxed);
+        if(b - tp > a->size - 1)
+        {
+            a = grow(a, b, tp);
+        }
+        a->put(b, t.release());
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    bool work_stealing_deque::pop(basic_task_ptr& t) NOEXCEPT
+    {
+        int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        buffer* a = _buffer.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t tp = _top.load(std::memory_order_relaxed);
+        if(tp > b)
+        {
+            // empty
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        basic_task* x = a->get(b);
+        if(tp == b)
+        {
+            // last element, race against thieves
+            bool won = _top.compare_exchange_strong(tp, tp + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            if(!won)
+            {
+                return false;
+            }
+        }
+        t.reset(x);
+        return true;
+    }
+
+    bool work_stealing_deque::steal(basic_task_ptr& t) NOEXCEPT
+    {
+        int64_t tp = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = _bottom.load(std::memory_order_acquire);
+        if(tp >= b)
+        {
+            return false;
+        }
+        buffer* a = _buffer.load(std::memory_order_acquire);
+        basic_task* x = a->get(tp);
+        if(!_top.compare_exchange_strong(tp, tp + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return false;
+        }
+        t.reset(x);
+        return true;
+    }
+
+    bool work_stealing_deque::empty() const NOEXCEPT
+    {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t tp = _top.load(std::memory_order_relaxed);
+        return tp >= b;
+    }
+
+}
@@ -0,0 +1,71 @@
+#ifndef _eventually_work_stealing_deque_hpp_
+#define _eventually_work_stealing_deque_hpp_
+
+#include <eventually/define.hpp>
+#include <eventually/task.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace eventually {
+
+    /**
+     * A Chase-Lev work stealing deque of tasks, using the memory orderings from
+     * "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013).
+     * Only the owner thread can push and pop at the bottom, any thread can steal
+     * from the top. The buffer grows when full and old buffers are kept alive
+     * until the deque is destroyed so that thieves never read freed memory.
+     */
+    class work_stealing_deque
+    {
+    private:
+        struct buffer
+        {
+            int64_t size;
+            std::unique_ptr<std::atomic<basic_task*>[]> tasks;
+
+            buffer(int64_t size);
+            basic_task* get(int64_t i) const NOEXCEPT;
+            void put(int64_t i, basic_task* t) NOEXCEPT;
+        };
+
+        std::atomic<int64_t> _top;
+        std::atomic<int64_t> _bottom;
+        std::atomic<buffer*> _buffer;
+        std::vector<std::unique_ptr<buffer>> _buffers;
+
+        buffer* grow(buffer* b, int64_t bottom, int64_t top);
+
+        work_stealing_deque(const work_stealing_deque&);
+        work_stealing_deque& operator=(const work_stealing_deque&);
+
+    public:
+        static const size_t default_capacity;
+
+        work_stealing_deque(size_t capacity=default_capacity);
+        ~work_stealing_deque();
+
+        /**
+         * Add a task at the bottom, only called by the owner
+         */
+        void push(basic_task_ptr&& t);
+
+        /**
+         * Take the newest task from the bottom, only called by the owner
+         * @return false if the deque was empty
+         */
+        bool pop(basic_task_ptr& t) NOEXCEPT;
+
+        /**
+         * Take the oldest task from the top, can be called by any thread
+         * @return false if the deque was empty or another thread won the task
+         */
+        bool steal(basic_task_ptr& t) NOEXCEPT;
+
+        bool empty() const NOEXCEPT;
+    };
+
+}
+
+#endif
@@ -4,10 +4,12 @@
 
 #include <memory>
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <vector>
 #include <eventually/is_callable.hpp>
 #include <eventually/connection.hpp>
+#include <eventually/future.hpp>
 
 namespace eventually {
 
@@ -20,37 +22,50 @@ namespace eventually {
         when_worker();
     public:
 
-        template <typename Work, typename... Results,
-            typename std::enable_if<is_callable<Work(Results...)>::value, int>::type = 0>
-        static auto work(Work& w, std::future<Results>&... fs) -> decltype(w(fs.get()...))
+        template <typename Work, typename... Futures,
+            typename std::enable_if<is_callable<Work(future_result_t<Futures>...)>::value, int>::type = 0>
+        static auto work(Work& w, Futures&... fs) -> decltype(w(fs.get()...))
         {
-            return w(std::forward<Results>(fs.get())...);
+            return w(fs.get()...);
         }
 
-        template <typename Work,
+        template <typename Work, typename Future,
+            typename std::enable_if<std::is_void<future_result_t<Future>>::value, int>::type = 0,
             typename std::enable_if<is_callable<Work()>::value, int>::type = 0>
-        static auto work(Work& w, std::future<void>& f) -> decltype(w())
+        static auto work(Work& w, Future& f) -> decltype(w())
         {
             f.wait();
             return w();
         }
 
-        template <typename Work, typename FinalResult, typename... Results>
-        static void promised_work(Work& w, std::promise<FinalResult>& p, std::future<Results>&... fs)
+        template <typename Work, typename FinalResult, typename... Futures>
+        static void promised_work(Work& w, promise<FinalResult>& p, Futures&... fs)
         {
             p.set_value(work(w, fs...));
         }
 
+        template <typename Work, typename... Futures>
+        static void promised_work(Work& w, promise<void>& p, Futures&... fs)
+        {
+            work(w, fs...);
+            p.set_value();
+        }
+
+        template <typename Work, typename FinalResult, typename... Results>
+        static void promised_call(Work& w, promise<FinalResult>& p, Results&&... rs)
+        {
+            p.set_value(w(std::forward<Results>(rs)...));
+        }
 
         template <typename Work, typename... Results>
-        static void promised_work(Work& w, std::promise<void>& p, std::future<Results>&... fs)
+        static void promised_call(Work& w, promise<void>& p, Results&&... rs)
         {
-            work(w, fs...);
+            w(std::forward<Results>(rs)...);
             p.set_value();
         }
 
-        template <typename Result, typename... Results>
-        static bool is_ready(const std::future<Result>& f, const std::future<Results>&... fs)
+        template <typename Future, typename... Futures>
+        static bool is_ready(const Future& f, const Futures&... fs)
         {
             if(!is_ready(f))
             {
@@ -66,28 +81,88 @@ namespace eventually {
             {
                 return true;
             }
-            return f.wait_for(std::chrono::milliseconds(1)) == std::future_status::ready;
+            return f.wait_for(std::chrono::seconds::zero()) == std::future_status::ready;
+        }
+
+        template <typename Result>
+        static bool is_ready(const future<Result>& f)
+        {
+            return !f.valid() || f.is_ready();
+        }
+
+        template <typename Future>
+        static bool is_ready(const std::vector<Future>& fs)
+        {
+            for(auto& f : fs)
+            {
+                if(!is_ready(f))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * The result of waiting for a vector of futures
+         */
+        template <typename Result>
+        struct all_result
+        {
+            typedef std::vector<Result> type;
+        };
+
+        template <typename Future,
+            typename std::enable_if<!std::is_void<future_result_t<Future>>::value, int>::type = 0>
+        static std::vector<future_result_t<Future>> get_all(std::vector<Future>& fs)
+        {
+            std::vector<future_result_t<Future>> results;
+            results.reserve(fs.size());
+            for(auto& f : fs)
+            {
+                results.push_back(f.get());
+            }
+            return results;
+        }
+
+        template <typename Future,
+            typename std::enable_if<std::is_void<future_result_t<Future>>::value, int>::type = 0>
+        static void get_all(std::vector<Future>& fs)
+        {
+            for(auto& f : fs)
+            {
+                f.get();
+            }
         }
 
     };
 
-    template<typename FinalResult>
+    template <>
+    struct when_worker::all_result<void>
+    {
+        typedef void type;
+    };
+
+    template<typename FinalResult, typename Connection>
     struct when_any_worker_data
     {
         size_t size;
         bool worked;
-        std::promise<FinalResult> promise;
+        eventually::promise<FinalResult> promise;
         std::mutex mutex;
-        connection conn;
+        Connection conn;
+        std::vector<weak_connection> branches;
 
-        when_any_worker_data(size_t size, connection& c):
+        when_any_worker_data(size_t size, Connection& c):
         size(size), worked(false), conn(c)
         {
+            branches.reserve(size);
         }
 
         when_any_worker_data(size_t size):
         size(size), worked(false)
         {
+            branches.reserve(size);
         }
     };
 
@@ -95,11 +170,12 @@ namespace eventually {
      * Used to share a promise between all the futures
      * when calling dispatcher::when_any
      */
-    template<typename FinalResult>
+    template<typename FinalResult, typename Connection = null_connection>
     class when_any_worker
     {
     private:
-        std::shared_ptr<when_any_worker_data<FinalResult>> _data;
+        typedef when_any_worker_data<FinalResult, Connection> data;
+        std::shared_ptr<data> _data;
 
         void catch_exception()
         {
@@ -114,35 +190,97 @@ namespace eventually {
             }
         }
 
+        bool finished()
+        {
+            std::lock_guard<std::mutex> lock_(_data->mutex);
+            return _data->worked;
+        }
+
+        /**
+         * The first future that is met takes the promise,
+         * it is fulfilled without holding the lock
+         */
+        bool take_promise(eventually::promise<FinalResult>& p, std::vector<weak_connection>& branches)
+        {
+            std::lock_guard<std::mutex> lock_(_data->mutex);
+            if(_data->worked)
+            {
+                return false;
+            }
+            _data->worked = true;
+            p = std::move(_data->promise);
+            branches.swap(_data->branches);
+            return true;
+        }
+
+        template <typename Work, typename... Results>
+        void finish(Work& w, size_t branch, Results&&... rs)
+        {
+            eventually::promise<FinalResult> p;
+            std::vector<weak_connection> branches;
+            if(!take_promise(p, branches))
+            {
+                return;
+            }
+            // the losing branches will not be used, stop their work
+            for(size_t i=0; i<branches.size(); ++i)
+            {
+                if(i != branch)
+                {
+                    branches[i].interrupt();
+                }
+            }
+            try
+            {
+                when_worker::promised_call(w, p, std::forward<Results>(rs)...);
+            }
+            catch(...)
+            {
+                p.set_exception(std::current_exception());
+            }
+        }
+
     public:
         when_any_worker(size_t size):
-        _data(std::make_shared<when_any_worker_data<FinalResult>>(size))
+        _data(std::make_shared<data>(size))
         {
         }
 
-        when_any_worker(size_t size, connection& c):
-        _data(std::make_shared<when_any_worker_data<FinalResult>>(size, c))
+        when_any_worker(size_t size, Connection& c):
+        _data(std::make_shared<data>(size, c))
         {
         }
 
-        template <typename Work, typename Result>
-        void work(Work& w, std::future<Result>& f)
+        /**
+         * Register the connection of a future, it is interrupted
+         * when another future is met first
+         * @return the branch index to pass to work
+         */
+        size_t add_branch(const weak_connection& c)
         {
+            std::lock_guard<std::mutex> lock_(_data->mutex);
+            if(_data->worked)
+            {
+                c.interrupt();
+            }
+            _data->branches.push_back(c);
+            return _data->branches.size() - 1;
+        }
+
+        template <typename Work, typename Future,
+            typename std::enable_if<!std::is_void<future_result_t<Future>>::value, int>::type = 0>
+        void work(Work& w, Future& f, size_t branch)
+        {
+            if(finished())
+            {
+                // a lost branch does not wait for its future
+                return;
+            }
             try
             {
                 _data->conn.interruption_point();
-                _data->mutex.lock();
-                if(!_data->worked)
-                {
-                    when_worker::promised_work(w, _data->promise, f);
-                    _data->worked = true;
-                    _data->mutex.unlock();
-                }
-                else
-                {
-                    _data->mutex.unlock();
-                    f.wait();
-                }
+                auto r = f.get();
+                finish(w, branch, std::move(r));
             }
             catch(...)
             {
@@ -150,13 +288,33 @@ namespace eventually {
             }
         }
 
-        std::future<FinalResult> get_future()
+        template <typename Work, typename Future,
+            typename std::enable_if<std::is_void<future_result_t<Future>>::value, int>::type = 0>
+        void work(Work& w, Future& f, size_t branch)
+        {
+            if(finished())
+            {
+                return;
+            }
+            try
+            {
+                _data->conn.interruption_point();
+                f.get();
+                finish(w, branch);
+            }
+            catch(...)
+            {
+                catch_exception();
+            }
+        }
+
+        future<FinalResult> get_future()
         {
             return _data->promise.get_future();
         }
     };
 
-    template<typename Result>
+    template<typename Result, typename Connection>
     struct when_every_worker_data
     {
         typedef std::vector<Result> container;
@@ -164,10 +322,10 @@ namespace eventually {
         size_t size;
         container results;
         std::mutex mutex;
-        std::promise<container> promise;
-        connection conn;        
+        eventually::promise<container> promise;
+        Connection conn;
 
-        when_every_worker_data(size_t size, connection& c):
+        when_every_worker_data(size_t size, Connection& c):
         size(size), conn(c)
         {
             results.reserve(size);
@@ -184,58 +342,71 @@ namespace eventually {
      * Used to share a promise between all the futures
      * when calling dispatcher::when_every
      */
-    template<typename Result>
+    template<typename Result, typename Connection = null_connection>
     class when_every_worker
     {
     public:
-        typedef when_every_worker_data<Result> data;
+        typedef when_every_worker_data<Result, Connection> data;
         typedef typename data::container container;
     private:
         std::shared_ptr<data> _data;
 
+        /**
+         * Call the work with the results so far, the promise
+         * is taken when all the futures are met
+         */
         template <typename Work,
             typename std::enable_if<is_callable<Work(container&)>::value, int>::type = 0>
-        void step(Work& w)
+        bool step(Work& w, eventually::promise<container>& p)
         {
             w(_data->results);
             if(_data->size == _data->results.size())
             {
-                _data->promise.set_value(_data->results);
+                p = std::move(_data->promise);
+                return true;
             }
+            return false;
         }
 
     public:
         when_every_worker(size_t size):
-        _data(std::make_shared<when_every_worker_data<Result>>(size))
+        _data(std::make_shared<data>(size))
         {
         }
 
-        when_every_worker(size_t size, connection& c):
-        _data(std::make_shared<when_every_worker_data<Result>>(size, c))
+        when_every_worker(size_t size, Connection& c):
+        _data(std::make_shared<data>(size, c))
         {
         }
 
-        template <typename Work,
+        template <typename Work, typename Future,
             typename std::enable_if<is_callable<Work(container&)>::value, int>::type = 0>
-        void work(Work& w, std::future<Result>& f)
+        void work(Work& w, Future& f)
         {
+            eventually::promise<container> p;
+            bool finished = false;
             try
             {
                 _data->conn.interruption_point();
                 Result r(f.get());
                 std::lock_guard<std::mutex> lock_(_data->mutex);
                 _data->results.push_back(r);
-                step(w);
+                finished = step(w, p);
             }
             catch(...)
             {
                 std::lock_guard<std::mutex> lock_(_data->mutex);
                 _data->size--;
-                step(w);
+                finished = step(w, p);
+            }
+            if(finished)
+            {
+                // no other future can change the results now
+                p.set_value(std::move(_data->results));
             }
         }
 
-        std::future<container> get_future()
+        future<container> get_future()
         {
             return _data->promise.get_future();
         }
@@ -245,7 +416,133 @@ namespace eventually {
     using when_every_container = typename when_every_worker<Result>::container;
 
     template <typename Result>
-    using when_every_future = std::future<when_every_container<Result>>;
+    using when_every_future = future<when_every_container<Result>>;
+
+    /**
+     * Order of the results of dispatcher::when_each
+     */
+    enum class when_each_order
+    {
+        completion,
+        input
+    };
+
+    template<typename Result, typename Connection>
+    struct when_each_worker_data
+    {
+        typedef std::vector<Result> container;
+
+        container results;
+        std::vector<char> filled;
+        std::atomic<size_t> next;
+        std::atomic<size_t> pending;
+        when_each_order order;
+        eventually::promise<container> promise;
+        Connection conn;
+
+        when_each_worker_data(size_t size, Connection& c, when_each_order o):
+        results(size), next(0), pending(size), order(o), conn(c)
+        {
+            if(order == when_each_order::input)
+            {
+                filled.resize(size, 0);
+            }
+        }
+    };
+
+    /**
+     * Used to share a promise between all the futures
+     * when calling dispatcher::when_each. Every result is moved
+     * to its own slot, so there is no lock and the work of
+     * different futures can run at the same time.
+     */
+    template<typename Result, typename Connection = null_connection>
+    class when_each_worker
+    {
+    public:
+        typedef when_each_worker_data<Result, Connection> data;
+        typedef typename data::container container;
+    private:
+        std::shared_ptr<data> _data;
+
+        void store(Result& r, size_t index)
+        {
+            if(_data->order == when_each_order::input)
+            {
+                _data->results[index] = std::move(r);
+                _data->filled[index] = 1;
+            }
+            else
+            {
+                _data->results[_data->next++] = std::move(r);
+            }
+        }
+
+        /**
+         * Called by the last future, remove the slots
+         * of the futures that failed
+         */
+        void finish()
+        {
+            auto& results = _data->results;
+            size_t size = _data->next;
+            if(_data->order == when_each_order::input)
+            {
+                size = 0;
+                for(size_t i=0; i<results.size(); ++i)
+                {
+                    if(_data->filled[i])
+                    {
+                        if(i != size)
+                        {
+                            results[size] = std::move(results[i]);
+                        }
+                        size++;
+                    }
+                }
+            }
+            results.erase(results.begin() + size, results.end());
+            _data->promise.set_value(std::move(results));
+        }
+
+    public:
+        when_each_worker(size_t size, Connection& c, when_each_order o):
+        _data(std::make_shared<data>(size, c, o))
+        {
+            if(size == 0)
+            {
+                finish();
+            }
+        }
+
+        /**
+         * Failed futures and work that throws are skipped
+         */
+        template <typename Work, typename Future,
+            typename std::enable_if<is_callable<Work(size_t, Result&)>::value, int>::type = 0>
+        void work(Work& w, Future& f, size_t index)
+        {
+            try
+            {
+                _data->conn.interruption_point();
+                Result r(f.get());
+                w(index, r);
+                store(r, index);
+            }
+            catch(...)
+            {
+            }
+            if(--_data->pending == 0)
+            {
+                finish();
+            }
+        }
+
+        future<container> get_future()
+        {
+            return _data->promise.get_future();
+        }
+    };
 
     /**
      * Used to catch an exception when getting a future
@@ -255,9 +552,10 @@ namespace eventually {
     private:
         when_throw_worker();
     public:
-        template <typename Exception = std::exception, typename Work, typename Result,
+        template <typename Exception = std::exception, typename Work, typename Future,
+        typename std::enable_if<!std::is_void<future_result_t<Future>>::value, int>::type = 0,
         typename std::enable_if<is_callable<Work(const Exception&)>::value, int>::type = 0>
-        static auto work(Work& w, std::future<Result>& f) -> Result
+        static auto work(Work& w, Future& f) -> future_result_t<Future>
         {
             try
             {
@@ -270,9 +568,10 @@ namespace eventually {
             }
         }
 
-        template <typename Exception = std::exception, typename Work,
+        template <typename Exception = std::exception, typename Work, typename Future,
+        typename std::enable_if<std::is_void<future_result_t<Future>>::value, int>::type = 0,
         typename std::enable_if<is_callable<Work(const Exception&)>::value, int>::type = 0>
-        static auto work(Work& w, std::future<void>& f) -> void
+        static auto work(Work& w, Future& f) -> void
         {
             try
             {
@@ -295,9 +594,10 @@ namespace eventually {
     private:
         when_throw_continue_worker();
     public:        
-        template <typename Work, typename Result, typename Exception = std::exception,
-            typename std::enable_if<is_callable_with_result<Work(const Exception&), Result>::value, int>::type = 0>
-        static auto work(Work& w, std::future<Result>& f) -> Result
+        template <typename Work, typename Future, typename Exception = std::exception,
+            typename std::enable_if<!std::is_void<future_result_t<Future>>::value, int>::type = 0,
+            typename std::enable_if<is_callable_with_result<Work(const Exception&), future_result_t<Future>>::value, int>::type = 0>
+        static auto work(Work& w, Future& f) -> future_result_t<Future>
         {
             try
             {
@@ -309,9 +609,10 @@ namespace eventually {
             }
         }
 
-        template <typename Work, typename Exception = std::exception,
+        template <typename Work, typename Future, typename Exception = std::exception,
+        typename std::enable_if<std::is_void<future_result_t<Future>>::value, int>::type = 0,
         typename std::enable_if<is_callable<Work(const Exception&)>::value, int>::type = 0>
-        static auto work(Work& w, std::future<void>& f) -> void
+        static auto work(Work& w, Future& f) -> void
         {
             try
             {
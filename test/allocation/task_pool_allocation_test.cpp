@@ -0,0 +1,156 @@
+#include <eventually/task_pool.hpp>
+#include <eventually/dispatcher.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include "gtest/gtest.h"
+
+/**
+ * These tests replace the global operator new to count the allocations,
+ * so they are built in their own executable to not change
+ * how the other tests allocate.
+ */
+
+using namespace eventually;
+
+namespace {
+
+    std::atomic<bool> count_allocations(false);
+    std::atomic<size_t> allocations(0);
+
+    /**
+     * Count the allocations done between start and stop
+     */
+    struct allocation_counter
+    {
+        allocation_counter()
+        {
+            allocations.store(0);
+            count_allocations.store(true);
+        }
+
+        size_t stop()
+        {
+            count_allocations.store(false);
+            return allocations.load();
+        }
+    };
+
+}
+
+void* operator new(size_t size)
+{
+    if(count_allocations.load())
+    {
+        allocations++;
+    }
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if(!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) NOEXCEPT
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) NOEXCEPT
+{
+    std::free(p);
+}
+
+TEST(task_pool_allocation, dispatch_does_not_allocate) {
+
+    const int tasks = 1000;
+    dispatcher d(new lockfree_task_queue(64));
+    int result = 0;
+
+    // fill the pool
+    for(int i=0; i<tasks; ++i)
+    {
+        auto f = d.dispatch([](int a, int b){
+            return a+b;
+        }, i, 1);
+        d.process_one();
+        result += f.get();
+    }
+
+    allocation_counter counter;
+    for(int i=0; i<tasks; ++i)
+    {
+        auto f = d.dispatch([](int a, int b){
+            return a+b;
+        }, i, 1);
+        d.process_one();
+        result += f.get();
+    }
+    ASSERT_EQ(0u, counter.stop());
+    ASSERT_LT(0, result);
+}
+
+TEST(task_pool_allocation, dispatch_void_does_not_allocate) {
+
+    const int tasks = 1000;
+    dispatcher d(new lockfree_task_queue(64));
+    int result = 0;
+
+    for(int i=0; i<tasks; ++i)
+    {
+        d.dispatch([&result](){
+            result++;
+        });
+        d.process_one();
+    }
+
+    allocation_counter counter;
+    for(int i=0; i<tasks; ++i)
+    {
+        d.dispatch([&result](){
+            result++;
+        });
+        d.process_one();
+    }
+    ASSERT_EQ(0u, counter.stop());
+    ASSERT_EQ(2*tasks, result);
+}
+
+TEST(task_pool_allocation, dispatch_with_connection) {
+
+    dispatcher d(new lockfree_task_queue(64));
+    connection c;
+    auto work = [](){
+        return 1;
+    };
+    // fill the pool with the blocks of the same task
+    auto warm = d.dispatch(c, work);
+    d.process_one();
+    ASSERT_EQ(1, warm.get());
+
+    // a connection passed by the caller does not allocate again
+    allocation_counter counter;
+    auto f = d.dispatch(c, work);
+    d.process_one();
+    ASSERT_EQ(0u, counter.stop());
+    ASSERT_EQ(1, f.get());
+}
+
+TEST(task_pool_allocation, wait_for_does_not_allocate) {
+
+    promise<int> p;
+    auto f = p.get_future();
+    ASSERT_EQ(std::future_status::timeout, f.wait_for(std::chrono::microseconds(1)));
+
+    // timed waits on a pending future reuse the same waiter
+    allocation_counter counter;
+    for(int i=0; i<1000; ++i)
+    {
+        ASSERT_EQ(std::future_status::timeout, f.wait_for(std::chrono::microseconds(1)));
+    }
+    ASSERT_EQ(0u, counter.stop());
+    p.set_value(1);
+    ASSERT_EQ(1, f.get());
+}
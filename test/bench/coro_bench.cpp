@@ -0,0 +1,102 @@
+#if defined(__cpp_impl_coroutine)
+
+#include <eventually/coro.hpp>
+#include <eventually/dispatcher.hpp>
+#include <benchmark/benchmark.h>
+
+using namespace eventually;
+
+namespace {
+
+    coro::task<int> schedule_chain(dispatcher& d, int length)
+    {
+        int result = 0;
+        for(int i=0; i<length; ++i)
+        {
+            co_await d.schedule();
+            result++;
+        }
+        co_return result;
+    }
+
+    coro::task<int> add_one(int i)
+    {
+        co_return i+1;
+    }
+
+    coro::task<int> task_chain(int length)
+    {
+        int result = 0;
+        for(int i=0; i<length; ++i)
+        {
+            result = co_await add_one(result);
+        }
+        co_return result;
+    }
+
+}
+
+/**
+ * Tasks per second of a chain of when() calls
+ * built and processed in the same thread
+ * @param range(0) length of the chain
+ */
+static void coro_when_chain(benchmark::State& state)
+{
+    const int length = state.range(0);
+    dispatcher d;
+    for(auto _ : state)
+    {
+        future<int> f = d.dispatch([](){
+            return 0;
+        });
+        for(int i=0; i<length; ++i)
+        {
+            f = d.when([](int i){
+                return i+1;
+            }, std::move(f));
+        }
+        d.process_all();
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations()*length);
+}
+BENCHMARK(coro_when_chain)->RangeMultiplier(10)->Range(10, 1000);
+
+/**
+ * Same steps as coro_when_chain done by a coroutine
+ * that continues in a new dispatcher task every step
+ */
+static void coro_schedule_chain(benchmark::State& state)
+{
+    const int length = state.range(0);
+    dispatcher d;
+    for(auto _ : state)
+    {
+        auto f = coro::spawn(d, schedule_chain(d, length));
+        d.process_all();
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations()*length);
+}
+BENCHMARK(coro_schedule_chain)->RangeMultiplier(10)->Range(10, 1000);
+
+/**
+ * Same steps as coro_when_chain done by a coroutine
+ * that awaits a coroutine task every step
+ */
+static void coro_task_chain(benchmark::State& state)
+{
+    const int length = state.range(0);
+    dispatcher d;
+    for(auto _ : state)
+    {
+        auto f = coro::spawn(d, task_chain(length));
+        d.process_all();
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations()*length);
+}
+BENCHMARK(coro_task_chain)->RangeMultiplier(10)->Range(10, 100000);
+
+#endif
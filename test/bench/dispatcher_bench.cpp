@@ -0,0 +1,352 @@
+#include <eventually/dispatcher.hpp>
+#include <eventually/strand.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+
+using namespace eventually;
+
+namespace {
+
+    template<typename Future>
+    Future chain_step(dispatcher& d, future<int>&& f);
+
+    template<>
+    future<int> chain_step(dispatcher& d, future<int>&& f)
+    {
+        return d.when([](int i){
+            return i+1;
+        }, std::move(f));
+    }
+
+    template<>
+    std::future<int> chain_step(dispatcher& d, future<int>&& f)
+    {
+        // slicing to std::future makes the dispatcher use the blocking path
+        return d.when([](int i){
+            return i+1;
+        }, std::future<int>(std::move(f)));
+    }
+
+}
+
+/**
+ * Latency of a chain of when() calls from the moment
+ * the first task is ready until the last one is done.
+ * @param range(0) length of the chain
+ */
+template<typename Future>
+static void when_chain(benchmark::State& state)
+{
+    const int length = state.range(0);
+    thread_dispatcher d(2);
+    for(auto _ : state)
+    {
+        state.PauseTiming();
+        std::atomic<bool> ready(false);
+        auto first = d.dispatch_retry([&ready](){
+            return ready.load();
+        }, [](){
+            return 0;
+        });
+        future<int> f(std::move(first));
+        for(int i=0; i<length; ++i)
+        {
+            f = future<int>(chain_step<Future>(d, std::move(f)));
+        }
+        state.ResumeTiming();
+
+        ready.store(true);
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations()*length);
+}
+BENCHMARK_TEMPLATE(when_chain, future<int>)->RangeMultiplier(10)->Range(10, 1000)->UseRealTime();
+BENCHMARK_TEMPLATE(when_chain, std::future<int>)->RangeMultiplier(10)->Range(10, 1000)->UseRealTime();
+
+/**
+ * Tasks per second of dispatching a small task and processing it
+ * in the same thread, the pooled path does not allocate.
+ */
+static void dispatch_process(benchmark::State& state)
+{
+    dispatcher d(new lockfree_task_queue(1024));
+    int i = 0;
+    for(auto _ : state)
+    {
+        auto f = d.dispatch([](int a, int b){
+            return a+b;
+        }, i++, 1);
+        d.process_one();
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(dispatch_process);
+
+/**
+ * Same as dispatch_process but passing a new connection each time
+ */
+static void dispatch_process_connection(benchmark::State& state)
+{
+    dispatcher d(new lockfree_task_queue(1024));
+    int i = 0;
+    for(auto _ : state)
+    {
+        connection c;
+        auto f = d.dispatch(c, [](int a, int b){
+            return a+b;
+        }, i++, 1);
+        d.process_one();
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(dispatch_process_connection);
+
+namespace {
+
+    template<typename Connection>
+    int run_task(Connection& c, int i)
+    {
+        auto t = make_task_ptr(c, [](int&, int&){
+            return true;
+        }, [](int a, int b){
+            return a+b;
+        }, std::move(i), 1);
+        auto f = t->get_future();
+        (*t)();
+        return f.get();
+    }
+
+}
+
+/**
+ * Cost of creating and running a task without a queue
+ * @param range(0) 0 with a null_connection like dispatch without connection,
+ * 1 with connection(nullptr) and 2 with a connection
+ */
+static void task_connection(benchmark::State& state)
+{
+    null_connection n;
+    connection c(nullptr);
+    if(state.range(0) == 2)
+    {
+        c = connection();
+    }
+    int i = 0;
+    for(auto _ : state)
+    {
+        if(state.range(0) == 0)
+        {
+            benchmark::DoNotOptimize(run_task(n, i++));
+        }
+        else
+        {
+            benchmark::DoNotOptimize(run_task(c, i++));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(task_connection)->Arg(0)->Arg(1)->Arg(2);
+
+/**
+ * Tasks per second of threads that share a dispatcher,
+ * each one dispatches small tasks and processes them
+ */
+static void dispatch_process_threads(benchmark::State& state)
+{
+    static dispatcher* d = nullptr;
+    if(state.thread_index() == 0)
+    {
+        d = new dispatcher(new lockfree_task_queue(1024));
+    }
+    int i = 0;
+    for(auto _ : state)
+    {
+        auto f = d->dispatch([](int a, int b){
+            return a+b;
+        }, i++, 1);
+        d->process_one();
+        // another thread can take the task, help until it is done
+        while(f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            d->process_one();
+        }
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+    if(state.thread_index() == 0)
+    {
+        delete d;
+        d = nullptr;
+    }
+}
+BENCHMARK(dispatch_process_threads)->ThreadRange(1, 8)->UseRealTime();
+
+/**
+ * Cost of waiting for many futures with when_all
+ * @param range(0) amount of futures
+ */
+static void when_all_fan_in(benchmark::State& state)
+{
+    const size_t count = state.range(0);
+    dispatcher d;
+    for(auto _ : state)
+    {
+        std::vector<future<int>> fs;
+        fs.reserve(count);
+        for(size_t i=0; i<count; ++i)
+        {
+            fs.push_back(d.dispatch([i](){
+                return (int)i;
+            }));
+        }
+        auto f = d.when_all(std::move(fs));
+        d.process_all();
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations()*count);
+}
+BENCHMARK(when_all_fan_in)->RangeMultiplier(8)->Range(8, 4096);
+
+/**
+ * Cost of when_all and when_every with eight futures
+ * @param range(0) 1 to use when_every
+ */
+static void when_fan_in_8(benchmark::State& state)
+{
+    dispatcher d;
+    auto task = [](){
+        return 1;
+    };
+    for(auto _ : state)
+    {
+        if(state.range(0))
+        {
+            auto f = d.when_every(d.dispatch(task), d.dispatch(task), d.dispatch(task), d.dispatch(task),
+                d.dispatch(task), d.dispatch(task), d.dispatch(task), d.dispatch(task));
+            d.process_all();
+            benchmark::DoNotOptimize(f.get());
+        }
+        else
+        {
+            auto f = d.when_all(d.dispatch(task), d.dispatch(task), d.dispatch(task), d.dispatch(task),
+                d.dispatch(task), d.dispatch(task), d.dispatch(task), d.dispatch(task));
+            d.process_all();
+            benchmark::DoNotOptimize(f.get());
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*8);
+}
+BENCHMARK(when_fan_in_8)->Arg(0)->Arg(1);
+
+/**
+ * Cost of collecting many results of 1KB with when_each
+ * @param range(0) amount of futures
+ */
+static void when_each_fan_in(benchmark::State& state)
+{
+    const size_t count = state.range(0);
+    dispatcher d;
+    for(auto _ : state)
+    {
+        std::vector<future<std::vector<char>>> fs;
+        fs.reserve(count);
+        for(size_t i=0; i<count; ++i)
+        {
+            fs.push_back(d.dispatch([](){
+                return std::vector<char>(1024);
+            }));
+        }
+        auto f = d.when_each([](size_t i, std::vector<char>& r){
+            benchmark::DoNotOptimize(r.data());
+        }, std::move(fs));
+        d.process_all();
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations()*count);
+}
+BENCHMARK(when_each_fan_in)->RangeMultiplier(8)->Range(8, 4096);
+
+/**
+ * Tasks per second that share a connection
+ * @param range(0) 1 to interrupt the connection before processing,
+ * 2 to interrupt a parent connection and purge the tasks
+ */
+static void connection_interrupt(benchmark::State& state)
+{
+    const size_t count = 1024;
+    dispatcher d;
+    std::vector<future<int>> fs;
+    fs.reserve(count);
+    for(auto _ : state)
+    {
+        connection parent;
+        connection c = parent.child();
+        for(size_t i=0; i<count; ++i)
+        {
+            fs.push_back(d.dispatch(c, [i](){
+                return (int)i;
+            }));
+        }
+        if(state.range(0) == 1)
+        {
+            c.interrupt();
+        }
+        else if(state.range(0) == 2)
+        {
+            parent.interrupt();
+            d.purge_interrupted();
+        }
+        d.process_all();
+        for(auto& f : fs)
+        {
+            f.wait();
+        }
+        fs.clear();
+    }
+    state.SetItemsProcessed(state.iterations()*count);
+}
+BENCHMARK(connection_interrupt)->Arg(0)->Arg(1)->Arg(2);
+
+/**
+ * Tasks per second of many strands that share a thread_dispatcher,
+ * every iteration dispatches a task to each strand
+ * @param range(0) amount of strands
+ * @param range(1) tasks per strand and iteration
+ */
+static void strand_fan_out(benchmark::State& state)
+{
+    thread_dispatcher d;
+    std::vector<std::unique_ptr<strand>> strands;
+    size_t count = state.range(0);
+    size_t tasks = state.range(1);
+    for(size_t i=0; i<count; ++i)
+    {
+        strands.emplace_back(new strand(d));
+    }
+    std::vector<future<void>> fs;
+    fs.reserve(count*tasks);
+    for(auto _ : state)
+    {
+        for(size_t j=0; j<tasks; ++j)
+        {
+            for(auto& s : strands)
+            {
+                fs.push_back(s->dispatch([](){}));
+            }
+        }
+        for(auto& f : fs)
+        {
+            f.wait();
+        }
+        fs.clear();
+    }
+    state.SetItemsProcessed(state.iterations()*count*tasks);
+}
+BENCHMARK(strand_fan_out)->Args({1, 10000})->Args({1000, 10})->Args({100000, 1})->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,160 @@
+#include <eventually/file_data_loader.hpp>
+#include <eventually/http_client.hpp>
+#include <eventually/http_request.hpp>
+#include <eventually/http_response.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace eventually;
+
+namespace {
+
+    const char* file_name = "eventually_bench.dat";
+    const size_t file_size = 1 << 18;
+
+    void write_file()
+    {
+        std::vector<char> content(file_size, 'x');
+        FILE* fh = fopen(file_name, "wb");
+        fwrite(content.data(), 1, content.size(), fh);
+        fclose(fh);
+    }
+
+#if defined(__unix__)
+    /**
+     * Answers every http request on a loopback port with a small body
+     */
+    class loopback_server
+    {
+    private:
+        int _socket;
+        int _port;
+        std::atomic<bool> _done;
+        std::thread _thread;
+
+        void run()
+        {
+            const std::string response =
+                "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok";
+            while(!_done.load())
+            {
+                int client = accept(_socket, nullptr, nullptr);
+                if(client < 0)
+                {
+                    continue;
+                }
+                std::string request;
+                char buffer[1024];
+                ssize_t n;
+                while(request.find("\r\n\r\n") == std::string::npos &&
+                    (n = recv(client, buffer, sizeof(buffer), 0)) > 0)
+                {
+                    request.append(buffer, n);
+                }
+                send(client, response.data(), response.size(), 0);
+                close(client);
+            }
+        }
+
+    public:
+        loopback_server():
+        _socket(socket(AF_INET, SOCK_STREAM, 0)), _port(0)
+        {
+            _done.store(false);
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t len = sizeof(addr);
+            bind(_socket, (sockaddr*)&addr, len);
+            listen(_socket, 128);
+            getsockname(_socket, (sockaddr*)&addr, &len);
+            _port = ntohs(addr.sin_port);
+            _thread = std::thread(&loopback_server::run, this);
+        }
+
+        ~loopback_server()
+        {
+            _done.store(true);
+            // wake up the accept call
+            shutdown(_socket, SHUT_RDWR);
+            close(_socket);
+            _thread.join();
+        }
+
+        std::string get_url() const
+        {
+            return "http://127.0.0.1:" + std::to_string(_port) + "/";
+        }
+    };
+#endif
+
+}
+
+/**
+ * Bytes per second that the file_data_loader reads
+ * @param range(0) block size, zero to read the file in one block
+ */
+static void file_data_loader_read(benchmark::State& state)
+{
+    write_file();
+    size_t block = state.range(0) ? state.range(0) : file_data_loader::nblock;
+    thread_dispatcher d(1);
+    file_data_loader loader(d, block);
+    for(auto _ : state)
+    {
+        auto data = loader.load(file_name).get();
+        if(data.size() != file_size)
+        {
+            state.SkipWithError("wrong file size");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations()*file_size);
+    remove(file_name);
+}
+BENCHMARK(file_data_loader_read)->Arg(64)->Arg(4096)->Arg(65536)->Arg(0)->UseRealTime();
+
+#if defined(__unix__)
+/**
+ * Requests per second of the http_client against a loopback server
+ * @param range(0) requests sent before waiting for them
+ */
+static void http_client_loopback(benchmark::State& state)
+{
+    const size_t count = state.range(0);
+    loopback_server server;
+    thread_dispatcher d(4);
+    http_client client(d);
+    http_request req(server.get_url());
+    std::vector<future<http_response>> fs;
+    for(auto _ : state)
+    {
+        for(size_t i=0; i<count; ++i)
+        {
+            fs.push_back(client.send(req));
+        }
+        for(auto& f : fs)
+        {
+            if(f.get().get_code() != 200)
+            {
+                state.SkipWithError("request failed");
+            }
+        }
+        fs.clear();
+    }
+    state.SetItemsProcessed(state.iterations()*count);
+}
+BENCHMARK(http_client_loopback)->Arg(1)->Arg(16)->UseRealTime();
+#endif
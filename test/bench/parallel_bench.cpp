@@ -0,0 +1,110 @@
+#include <eventually/parallel.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace eventually;
+
+namespace {
+
+    const size_t array_size = 1 << 22;
+
+    void thread_counts(benchmark::internal::Benchmark* b)
+    {
+        size_t max = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        for(size_t i=1; i<max; i*=2)
+        {
+            b->Arg(i);
+        }
+        b->Arg(max);
+    }
+
+    float element_work(float v)
+    {
+        return std::sqrt(v) * 0.5f + 1.0f;
+    }
+
+}
+
+static void serial_transform(benchmark::State& state)
+{
+    std::vector<float> values(array_size, 2.0f);
+    std::vector<float> results(array_size);
+    for(auto _ : state)
+    {
+        std::transform(values.begin(), values.end(), results.begin(), &element_work);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations()*array_size);
+}
+BENCHMARK(serial_transform)->UseRealTime();
+
+/**
+ * @param range(0) thread count
+ */
+static void parallel_transform_array(benchmark::State& state)
+{
+    thread_dispatcher d(state.range(0));
+    std::vector<float> values(array_size, 2.0f);
+    std::vector<float> results(array_size);
+    for(auto _ : state)
+    {
+        parallel_transform(d, values.begin(), values.end(), results.begin(), &element_work);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations()*array_size);
+}
+BENCHMARK(parallel_transform_array)->Apply(thread_counts)->UseRealTime();
+
+static void serial_reduce(benchmark::State& state)
+{
+    std::vector<double> values(array_size, 1.5);
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(std::accumulate(values.begin(), values.end(), 0.0));
+    }
+    state.SetItemsProcessed(state.iterations()*array_size);
+}
+BENCHMARK(serial_reduce)->UseRealTime();
+
+/**
+ * @param range(0) thread count
+ */
+static void parallel_reduce_array(benchmark::State& state)
+{
+    thread_dispatcher d(state.range(0));
+    std::vector<double> values(array_size, 1.5);
+    for(auto _ : state)
+    {
+        benchmark::DoNotOptimize(parallel_reduce(d, values.begin(), values.end(), 0.0,
+            [](double a, double b){
+                return a+b;
+            }));
+    }
+    state.SetItemsProcessed(state.iterations()*array_size);
+}
+BENCHMARK(parallel_reduce_array)->Apply(thread_counts)->UseRealTime();
+
+/**
+ * parallel_for with different grain sizes
+ * @param range(0) grain, 0 picks one
+ */
+static void parallel_for_grain(benchmark::State& state)
+{
+    thread_dispatcher d;
+    std::vector<float> values(array_size, 2.0f);
+    size_t grain = state.range(0);
+    for(auto _ : state)
+    {
+        parallel_for(d, values.begin(), values.end(), [](float& v){
+            v = element_work(v);
+        }, grain);
+        benchmark::DoNotOptimize(values.data());
+    }
+    state.SetItemsProcessed(state.iterations()*array_size);
+}
+BENCHMARK(parallel_for_grain)->Arg(0)->Arg(1024)->Arg(65536)->UseRealTime();
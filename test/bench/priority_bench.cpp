@@ -0,0 +1,78 @@
+#include <eventually/thread_dispatcher.hpp>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace eventually;
+
+namespace {
+
+    typedef std::chrono::steady_clock clock;
+
+    const size_t background_tasks = 2000;
+    const size_t probe_tasks = 100;
+
+    uint64_t background_work(uint64_t seed)
+    {
+        for(size_t i=0; i<10000; ++i)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+        }
+        return seed;
+    }
+
+    double percentile(std::vector<double>& values, double p)
+    {
+        std::sort(values.begin(), values.end());
+        size_t i = std::min(values.size()-1, (size_t)(p*values.size()));
+        return values[i];
+    }
+
+}
+
+/**
+ * Latency from dispatch to start of short tasks dispatched
+ * while the dispatcher is saturated with background work
+ * @param range(0) 1 to dispatch the probes with high priority
+ */
+static void priority_latency(benchmark::State& state)
+{
+    thread_dispatcher d(std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    task_priority priority = state.range(0) ? task_priority::high : task_priority::normal;
+    std::vector<double> latencies;
+    std::vector<future<uint64_t>> background;
+    std::vector<future<double>> probes;
+
+    for(auto _ : state)
+    {
+        for(size_t i=0; i<background_tasks; ++i)
+        {
+            background.push_back(d.dispatch(&background_work, uint64_t(i+1)));
+        }
+        for(size_t i=0; i<probe_tasks; ++i)
+        {
+            probes.push_back(d.dispatch(priority, [](clock::time_point start){
+                return std::chrono::duration<double, std::micro>(clock::now() - start).count();
+            }, clock::now()));
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        for(auto& f : probes)
+        {
+            latencies.push_back(f.get());
+        }
+        for(auto& f : background)
+        {
+            benchmark::DoNotOptimize(f.get());
+        }
+        probes.clear();
+        background.clear();
+    }
+    state.counters["p50_us"] = percentile(latencies, 0.5);
+    state.counters["p99_us"] = percentile(latencies, 0.99);
+}
+BENCHMARK(priority_latency)->Arg(0)->Arg(1)->Iterations(5)->UseRealTime();
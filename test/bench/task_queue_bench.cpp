@@ -0,0 +1,80 @@
+#include <eventually/dispatcher.hpp>
+#include <eventually/task_queue.hpp>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace eventually;
+
+namespace {
+
+    const size_t contention_tasks = 1 << 16;
+
+    void contention_args(benchmark::internal::Benchmark* b)
+    {
+        // producers, consumers
+        b->Args({1, 1});
+        b->Args({4, 1});
+        b->Args({8, 2});
+        b->Args({32, 1});
+        b->Args({32, 4});
+    }
+
+}
+
+/**
+ * Many threads dispatch small tasks into a dispatcher
+ * while other threads process them.
+ */
+template<typename Queue>
+static void dispatcher_contention(benchmark::State& state)
+{
+    const size_t producers = state.range(0);
+    const size_t consumers = state.range(1);
+    const size_t tasks = contention_tasks / producers;
+
+    for(auto _ : state)
+    {
+        dispatcher d(new Queue());
+        std::atomic<size_t> processed(0);
+        std::atomic<bool> done(false);
+        std::vector<std::thread> threads;
+
+        for(size_t i=0; i<consumers; ++i)
+        {
+            threads.push_back(std::thread([&d, &done](){
+                while(!done.load(std::memory_order_relaxed))
+                {
+                    if(!d.process_one())
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            }));
+        }
+        for(size_t i=0; i<producers; ++i)
+        {
+            threads.push_back(std::thread([&d, &processed, tasks](){
+                for(size_t j=0; j<tasks; ++j)
+                {
+                    d.dispatch([&processed](){
+                        processed.fetch_add(1, std::memory_order_relaxed);
+                    });
+                }
+            }));
+        }
+        while(processed.load() < tasks*producers)
+        {
+            std::this_thread::yield();
+        }
+        done.store(true);
+        for(auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*tasks*producers);
+}
+BENCHMARK_TEMPLATE(dispatcher_contention, locked_task_queue)->Apply(contention_args)->UseRealTime();
+BENCHMARK_TEMPLATE(dispatcher_contention, lockfree_task_queue)->Apply(contention_args)->UseRealTime();
@@ -0,0 +1,267 @@
+#include <eventually/thread_dispatcher.hpp>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace eventually;
+
+namespace {
+
+    const size_t cpu_tasks = 1024;
+    const size_t cpu_task_size = 20000;
+
+    /**
+     * Some cpu bound work that the optimizer cannot fold
+     */
+    uint64_t cpu_work(uint64_t seed)
+    {
+        for(size_t i=0; i<cpu_task_size; ++i)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+        }
+        return seed;
+    }
+
+    void thread_counts(benchmark::internal::Benchmark* b)
+    {
+        size_t max = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        for(size_t i=1; i<max; i*=2)
+        {
+            b->Arg(i);
+        }
+        b->Arg(max);
+    }
+
+    void thread_flag_args(benchmark::internal::Benchmark* b)
+    {
+        size_t max = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        for(int ws=0; ws<2; ++ws)
+        {
+            for(size_t i=1; i<max; i*=2)
+            {
+                b->Args({(int64_t)i, ws});
+            }
+            b->Args({(int64_t)max, ws});
+        }
+    }
+
+}
+
+static void serial_cpu_work(benchmark::State& state)
+{
+    for(auto _ : state)
+    {
+        for(size_t i=0; i<cpu_tasks; ++i)
+        {
+            benchmark::DoNotOptimize(cpu_work(i+1));
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*cpu_tasks);
+}
+BENCHMARK(serial_cpu_work)->UseRealTime();
+
+static void thread_dispatcher_cpu_work(benchmark::State& state)
+{
+    thread_dispatcher d(state.range(0));
+    std::vector<std::future<uint64_t>> fs;
+    fs.reserve(cpu_tasks);
+    for(auto _ : state)
+    {
+        for(size_t i=0; i<cpu_tasks; ++i)
+        {
+            fs.push_back(d.dispatch(&cpu_work, uint64_t(i+1)));
+        }
+        for(auto& f : fs)
+        {
+            benchmark::DoNotOptimize(f.get());
+        }
+        fs.clear();
+    }
+    state.SetItemsProcessed(state.iterations()*cpu_tasks);
+}
+BENCHMARK(thread_dispatcher_cpu_work)->Apply(thread_counts)->UseRealTime();
+
+/**
+ * Tasks that recursively dispatch two more tasks from inside the workers
+ * @param range(0) thread count
+ * @param range(1) 1 to use work stealing
+ */
+static void thread_dispatcher_fan_out(benchmark::State& state)
+{
+    const int depth = 14;
+    thread_dispatcher::options opts;
+    opts.thread_count = state.range(0);
+    opts.work_stealing = state.range(1) != 0;
+    thread_dispatcher d(opts);
+    std::atomic<int> leaves(0);
+
+    std::function<void(int)> fan_out = [&d, &leaves, &fan_out](int level){
+        if(level == 0)
+        {
+            leaves.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        d.dispatch(fan_out, level-1);
+        d.dispatch(fan_out, level-1);
+    };
+
+    for(auto _ : state)
+    {
+        leaves.store(0);
+        d.dispatch(fan_out, depth);
+        while(leaves.load() < (1 << depth))
+        {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations()*((2 << depth) - 1));
+}
+BENCHMARK(thread_dispatcher_fan_out)->Apply(thread_flag_args)->UseRealTime();
+
+/**
+ * Dispatch a lot of small tasks one by one or in one dispatch_bulk call
+ * @param range(0) thread count
+ * @param range(1) 1 to use dispatch_bulk
+ */
+static void thread_dispatcher_bulk(benchmark::State& state)
+{
+    const size_t tasks = 10000;
+    thread_dispatcher d(state.range(0));
+    bool bulk = state.range(1) != 0;
+    std::atomic<size_t> done(0);
+    auto work = [&done](size_t i){
+        done.fetch_add(1, std::memory_order_relaxed);
+    };
+    std::vector<future<void>> fs;
+    fs.reserve(tasks);
+
+    for(auto _ : state)
+    {
+        done.store(0);
+        if(bulk)
+        {
+            fs = d.dispatch_bulk(tasks, work);
+        }
+        else
+        {
+            for(size_t i=0; i<tasks; ++i)
+            {
+                fs.push_back(d.dispatch(work, size_t(i)));
+            }
+        }
+        while(done.load() < tasks)
+        {
+            std::this_thread::yield();
+        }
+        fs.clear();
+    }
+    state.SetItemsProcessed(state.iterations()*tasks);
+}
+BENCHMARK(thread_dispatcher_bulk)->Apply(thread_flag_args)->UseRealTime();
+
+/**
+ * Time from dispatching a task to running it when all the threads are idle
+ * @param range(0) thread count
+ */
+static void thread_dispatcher_wake_latency(benchmark::State& state)
+{
+    typedef thread_dispatcher::clock clock;
+    thread_dispatcher d(state.range(0));
+    for(auto _ : state)
+    {
+        // let the threads go to sleep
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        auto start = clock::now();
+        auto f = d.dispatch([](){
+            return clock::now();
+        });
+        auto end = f.get();
+        state.SetIterationTime(std::chrono::duration<double>(end - start).count());
+    }
+}
+BENCHMARK(thread_dispatcher_wake_latency)->Apply(thread_counts)->UseManualTime();
+
+/**
+ * Cpu used by an idle dispatcher
+ * @param range(0) thread count
+ * @param range(1) 1 to add a task that is never ready
+ */
+static void thread_dispatcher_idle_cpu(benchmark::State& state)
+{
+    const auto idle = std::chrono::milliseconds(100);
+    double cpu = 0.0;
+    for(auto _ : state)
+    {
+        std::atomic<bool> ready(false);
+        {
+            thread_dispatcher d(state.range(0));
+            if(state.range(1))
+            {
+                d.dispatch_retry([&ready](){
+                    return ready.load();
+                }, [](){});
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            std::clock_t start = std::clock();
+            std::this_thread::sleep_for(idle);
+            cpu += double(std::clock() - start) / CLOCKS_PER_SEC;
+            ready.store(true);
+        }
+    }
+    state.counters["cpu_percent"] = 100.0 * cpu /
+        (state.iterations() * std::chrono::duration<double>(idle).count());
+}
+BENCHMARK(thread_dispatcher_idle_cpu)->Apply(thread_flag_args)->Iterations(5)->UseRealTime();
+
+/**
+ * Memory bound tasks that sum chunks of an array bigger than the caches,
+ * the threads that touch the array first also read it
+ * @param range(0) thread count
+ * @param range(1) 1 to pin the threads and group them by numa node
+ */
+static void thread_dispatcher_memory_bound(benchmark::State& state)
+{
+    const size_t array_size = 1 << 24;
+    const size_t chunk_count = 64;
+    const size_t chunk_size = array_size / chunk_count;
+    thread_dispatcher::options opts;
+    opts.thread_count = state.range(0);
+    opts.pin_threads = state.range(1) != 0;
+    opts.numa = state.range(1) != 0;
+    thread_dispatcher d(opts);
+    std::unique_ptr<uint64_t[]> values(new uint64_t[array_size]);
+    uint64_t* data = values.get();
+    for(auto& f : d.dispatch_bulk(chunk_count, [data, chunk_size](size_t i){
+        std::fill(data + i*chunk_size, data + (i+1)*chunk_size, i);
+    }))
+    {
+        f.get();
+    }
+    for(auto _ : state)
+    {
+        auto fs = d.dispatch_bulk(chunk_count, [data, chunk_size](size_t i){
+            uint64_t sum = 0;
+            for(size_t j=i*chunk_size; j<(i+1)*chunk_size; ++j)
+            {
+                sum += data[j];
+            }
+            return sum;
+        });
+        for(auto& f : fs)
+        {
+            benchmark::DoNotOptimize(f.get());
+        }
+    }
+    state.SetBytesProcessed(state.iterations()*array_size*sizeof(uint64_t));
+}
+BENCHMARK(thread_dispatcher_memory_bound)->Apply(thread_flag_args)->UseRealTime();
@@ -0,0 +1,93 @@
+#include <eventually/dispatcher.hpp>
+#include <eventually/timer_wheel.hpp>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace eventually;
+
+namespace {
+
+    const size_t timer_count = 1000000;
+
+    class empty_task : public basic_task
+    {
+    public:
+        bool operator()()
+        {
+            return true;
+        }
+    };
+
+}
+
+/**
+ * Add 1M timers spread over an hour to a dispatcher
+ */
+static void timer_dispatch_after(benchmark::State& state)
+{
+    for(auto _ : state)
+    {
+        std::unique_ptr<dispatcher> d(new dispatcher());
+        for(size_t i=0; i<timer_count; ++i)
+        {
+            d->dispatch_after(std::chrono::milliseconds((i * 7919) % 3600000), [](){});
+        }
+        state.PauseTiming();
+        d.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations()*timer_count);
+}
+BENCHMARK(timer_dispatch_after)->Unit(benchmark::kMillisecond);
+
+/**
+ * Add 1M timers to a wheel and advance it until all of them expire
+ * @param range(0) ticks between the first and the last timer
+ */
+static void timer_wheel_expire(benchmark::State& state)
+{
+    timer_wheel::tick spread = state.range(0);
+    std::vector<basic_task_ptr> expired;
+    expired.reserve(timer_count);
+    for(auto _ : state)
+    {
+        timer_wheel w;
+        for(size_t i=0; i<timer_count; ++i)
+        {
+            w.add(1 + (i * 7919) % spread, basic_task_ptr(new empty_task()));
+        }
+        timer_wheel::tick next;
+        while(w.next(next))
+        {
+            w.advance(next, expired);
+        }
+        benchmark::DoNotOptimize(expired.data());
+        expired.clear();
+    }
+    state.SetItemsProcessed(state.iterations()*timer_count);
+}
+BENCHMARK(timer_wheel_expire)->Arg(1000)->Arg(3600000)->Unit(benchmark::kMillisecond);
+
+/**
+ * Dispatch and process small tasks while 1M timers are pending
+ */
+static void dispatch_with_pending_timers(benchmark::State& state)
+{
+    dispatcher d;
+    for(size_t i=0; i<timer_count; ++i)
+    {
+        d.dispatch_after(std::chrono::hours(1) + std::chrono::milliseconds(i), [](){});
+    }
+    for(auto _ : state)
+    {
+        auto f = d.dispatch([](){
+            return 1;
+        });
+        d.process_one();
+        benchmark::DoNotOptimize(f.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(dispatch_with_pending_timers);
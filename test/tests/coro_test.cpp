@@ -0,0 +1,121 @@
+#if defined(__cpp_impl_coroutine)
+
+#include <eventually/coro.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <stdexcept>
+#include <thread>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+namespace {
+
+    coro::task<int> add(int a, int b)
+    {
+        co_return a+b;
+    }
+
+    coro::task<int> chain(int n)
+    {
+        int result = 0;
+        for(int i=0; i<n; ++i)
+        {
+            result = co_await add(result, 1);
+        }
+        co_return result;
+    }
+
+    coro::task<void> fail()
+    {
+        throw std::runtime_error("test");
+        co_return;
+    }
+}
+
+TEST(coro, task) {
+
+    dispatcher d;
+    auto f = coro::spawn(d, chain(1000));
+    d.process_all();
+
+    ASSERT_EQ(1000, f.get());
+}
+
+TEST(coro, exception) {
+
+    dispatcher d;
+    auto f = coro::spawn(d, fail());
+    d.process_all();
+
+    ASSERT_THROW(f.get(), std::runtime_error);
+}
+
+TEST(coro, schedule) {
+
+    thread_dispatcher d(2);
+    auto caller = std::this_thread::get_id();
+    auto f = coro::spawn(d, [&d, caller]() -> coro::task<bool> {
+        co_await d.schedule();
+        co_return std::this_thread::get_id() != caller;
+    }());
+
+    ASSERT_TRUE(f.get());
+}
+
+TEST(coro, future) {
+
+    thread_dispatcher td(1);
+    dispatcher d;
+    auto f = coro::spawn(d, [&td]() -> coro::task<int> {
+        int a = co_await td.dispatch([](){
+            return 2;
+        });
+        int b = co_await td.dispatch([](){
+            return 3;
+        });
+        co_return a+b;
+    }());
+    d.process_all();
+
+    ASSERT_EQ(5, f.get());
+}
+
+TEST(coro, when) {
+
+    dispatcher d;
+    auto f = d.when([](int c){
+        return 2*c;
+    }, coro::spawn(d, add(2, 3)));
+    d.process_all();
+
+    ASSERT_EQ(10, f.get());
+}
+
+TEST(coro, connection) {
+
+    dispatcher d;
+    connection c;
+    bool resumed = false;
+    auto f = coro::spawn(d, [&d, &c, &resumed]() -> coro::task<void> {
+        co_await d.schedule(c);
+        resumed = true;
+    }());
+    c.interrupt();
+    d.process_all();
+
+    ASSERT_FALSE(resumed);
+    ASSERT_THROW(f.get(), connection_interrupted);
+}
+
+TEST(coro, destroy) {
+
+    future<int> f;
+    {
+        dispatcher d;
+        f = coro::spawn(d, add(1, 2));
+    }
+
+    ASSERT_THROW(f.get(), connection_interrupted);
+}
+
+#endif
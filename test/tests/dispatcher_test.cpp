@@ -1,4 +1,9 @@
 #include <eventually/dispatcher.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <thread>
 #include "gtest/gtest.h"
 
 using namespace eventually;
@@ -330,6 +335,36 @@ TEST(dispatcher, when_any_cancel) {
     ASSERT_TRUE(threw);
 }
 
+TEST(dispatcher, when_any_interrupt) {
+
+    dispatcher d;
+    dispatcher work;
+    connection c1;
+    connection c2;
+    bool called = false;
+
+    auto f1 = work.dispatch(c1, [](){
+        return 1;
+    });
+    auto f2 = work.dispatch(c2, [&called](){
+        called = true;
+        return 2;
+    });
+    auto f = d.when_any([](int a){
+        return a;
+    }, std::move(f1), std::move(f2));
+
+    work.process_one();
+    d.process_all();
+    work.process_all();
+    d.process_all();
+
+    ASSERT_EQ(1, f.get());
+    ASSERT_FALSE(called);
+    ASSERT_FALSE(c1.interrupted());
+    ASSERT_TRUE(c2.interrupted());
+}
+
 TEST(dispatcher, when_every) {
 
     dispatcher d;
@@ -396,6 +431,72 @@ TEST(dispatcher, when_every_cancel) {
     ASSERT_EQ(0, t.size());
 }
 
+TEST(dispatcher, when_each) {
+
+    dispatcher d;
+    dispatcher work;
+    std::vector<future<int>> fs;
+    for(int i=0; i<3; ++i)
+    {
+        fs.push_back(work.dispatch([i](){
+            return 10*i;
+        }));
+    }
+    std::vector<size_t> calls;
+    auto f = d.when_each([&calls](size_t i, int& r){
+        calls.push_back(i);
+        r++;
+    }, std::move(fs));
+
+    work.process_all();
+    d.process_all();
+    auto t = f.get();
+
+    ASSERT_EQ(3u, calls.size());
+    ASSERT_EQ(3u, t.size());
+    ASSERT_EQ(1, t[0]);
+    ASSERT_EQ(11, t[1]);
+    ASSERT_EQ(21, t[2]);
+}
+
+TEST(dispatcher, when_each_order) {
+
+    dispatcher d;
+    std::vector<promise<int>> ps(4);
+    std::vector<future<int>> fs;
+    for(auto& p : ps)
+    {
+        fs.push_back(p.get_future());
+    }
+    auto f = d.when_each([](size_t i, int& r){
+        if(i == 1)
+        {
+            throw test_exception();
+        }
+    }, std::move(fs), when_each_order::input);
+
+    ps[3].set_value(3);
+    ps[2].set_exception(std::make_exception_ptr(test_exception()));
+    ps[1].set_value(1);
+    ps[0].set_value(0);
+    d.process_all();
+    auto t = f.get();
+
+    ASSERT_EQ(2u, t.size());
+    ASSERT_EQ(0, t[0]);
+    ASSERT_EQ(3, t[1]);
+}
+
+TEST(dispatcher, when_each_empty) {
+
+    dispatcher d;
+    auto f = d.when_each([](size_t i, int& r){
+    }, std::vector<future<int>>());
+
+    ASSERT_TRUE(f.is_ready());
+    ASSERT_EQ(0u, f.get().size());
+}
+
 
 TEST(dispatcher, connection) {
 
@@ -414,6 +515,83 @@ TEST(dispatcher, connection) {
     ASSERT_FALSE(done);
 }
 
+TEST(dispatcher, connection_when_get) {
+
+    dispatcher d;
+    connection c;
+
+    // the future of the first task is released inside the locked work
+    auto f = d.when(c, [](int a){
+        return a+1;
+    }, d.dispatch(c, [](){
+        return 1;
+    }));
+    auto f2 = d.dispatch_future(c, [](future<int>&& f){
+        return f.get()+1;
+    }, d.dispatch(c, [](){
+        return 1;
+    }));
+
+    d.process_all();
+
+    ASSERT_EQ(2, f.get());
+    ASSERT_EQ(2, f2.get());
+}
+
+TEST(dispatcher, connection_child) {
+
+    connection parent;
+    connection child = parent.child();
+    connection grandchild = child.child();
+    connection other = connection(nullptr).child();
+
+    child.interrupt();
+    ASSERT_FALSE(parent.interrupted());
+    ASSERT_TRUE(grandchild.interrupted());
+
+    connection sibling = parent.child();
+    parent.interrupt();
+    ASSERT_TRUE(sibling.interrupted());
+    ASSERT_THROW(sibling.interruption_point(), connection_interrupted);
+    ASSERT_FALSE(other.interrupted());
+}
+
+TEST(dispatcher, purge_interrupted) {
+
+    dispatcher d;
+    connection screen;
+    int done = 0;
+    std::vector<future<void>> fs;
+    for(int i=0; i<3; ++i)
+    {
+        connection c = screen.child();
+        fs.push_back(d.dispatch(c, [&done](){
+            done++;
+        }));
+    }
+    connection c = screen.child();
+    auto timer = d.dispatch_after(std::chrono::hours(1), c, [&done](){
+        done++;
+    });
+    auto other = d.dispatch([&done](){
+        done++;
+    });
+
+    screen.interrupt();
+    ASSERT_EQ(4u, d.purge_interrupted());
+    ASSERT_EQ(1u, d.get_queue_size());
+    for(auto& f : fs)
+    {
+        ASSERT_TRUE(f.is_ready());
+        ASSERT_THROW(f.get(), connection_interrupted);
+    }
+    ASSERT_THROW(timer.get(), connection_interrupted);
+
+    d.process_all();
+    other.get();
+    ASSERT_EQ(1, done);
+}
+
 TEST(dispatcher, connection_interrupted_exception) {
 
     dispatcher d;
@@ -460,4 +638,451 @@ TEST(dispatcher, process_all) {
 
     ASSERT_EQ(5, f1.get());
     ASSERT_EQ(-1, f2.get());
-}
\ No newline at end of file
+}
+TEST(dispatcher, when_waits_for_completion) {
+
+    dispatcher d1;
+    dispatcher d2;
+
+    auto f = d1.when([](int c){
+        return 2.0f*c ;
+    }, d2.dispatch([](int a, int b){
+        return a+b;
+    }, 2, 3));
+
+    // the continuation is not queued until the task is done
+    ASSERT_FALSE(d1.process_all());
+
+    d2.process_one();
+
+    ASSERT_TRUE(d1.process_one());
+    ASSERT_FLOAT_EQ(10.0f, f.get());
+}
+
+TEST(dispatcher, when_all_waits_for_all) {
+
+    dispatcher d1;
+    dispatcher d2;
+
+    auto f = d1.when_all([](int a, int b){
+        return a*b;
+    }, d2.dispatch([](){
+        return 2;
+    }), d2.dispatch([](){
+        return 3;
+    }));
+
+    d2.process_one();
+    ASSERT_FALSE(d1.process_all());
+    d2.process_one();
+    ASSERT_TRUE(d1.process_all());
+
+    ASSERT_EQ(6, f.get());
+}
+
+TEST(dispatcher, when_std_future) {
+
+    dispatcher d;
+    std::promise<int> p;
+    p.set_value(3);
+
+    auto f = d.when([](int c){
+        return 2*c;
+    }, p.get_future());
+
+    d.process_all();
+
+    ASSERT_EQ(6, f.get());
+}
+
+TEST(dispatcher, when_broken_promise) {
+
+    dispatcher d1;
+    future<float> f;
+    {
+        dispatcher d2;
+        f = d1.when([](int c){
+            return 2.0f*c ;
+        }, d2.dispatch([](){
+            return 1;
+        }));
+    }
+
+    d1.process_all();
+
+    ASSERT_THROW(f.get(), std::future_error);
+}
+
+TEST(dispatcher, when_dispatcher_destroyed) {
+
+    dispatcher d2;
+    auto f1 = d2.dispatch([](){
+        return 1;
+    });
+    {
+        dispatcher d1;
+        d1.when([](int c){
+            return 2.0f*c ;
+        }, std::move(f1));
+    }
+
+    // completing the task does not push to the destroyed dispatcher
+    ASSERT_TRUE(d2.process_all());
+}
+
+TEST(dispatcher, never_ready_task) {
+
+    dispatcher d;
+    const int tasks = 10000;
+    int retries = 0;
+    int done = 0;
+
+    d.dispatch_retry([&retries](){
+        retries++;
+        return false;
+    }, [](){
+    });
+    for(int i=0; i<tasks; ++i)
+    {
+        d.dispatch([&done](){
+            done++;
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while(done < tasks)
+    {
+        d.process_one();
+    }
+    auto duration = std::chrono::steady_clock::now() - start;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    RecordProperty("completion_ms", (int)ms);
+
+    // the blocked task is only checked every retry interval
+    ASSERT_EQ(tasks, done);
+    ASSERT_GT(tasks, retries);
+    ASSERT_GT(5000, ms);
+}
+
+TEST(dispatcher, process_all_waiting) {
+
+    dispatcher d;
+    bool ready = false;
+    int done = 0;
+
+    d.dispatch_retry([&ready](){
+        return ready;
+    }, [&done](){
+        done++;
+    });
+    d.dispatch([&done](){
+        done++;
+    });
+
+    // returns with the task parked instead of spinning on it
+    ASSERT_TRUE(d.process_all());
+    ASSERT_EQ(1, done);
+    ASSERT_FALSE(d.process_all());
+
+    ready = true;
+    ASSERT_TRUE(d.process_all());
+    ASSERT_EQ(2, done);
+}
+
+TEST(dispatcher, retry_waiting) {
+
+    dispatcher d;
+    d.set_retry_interval(std::chrono::hours(1));
+    bool ready = false;
+    bool done = false;
+
+    d.dispatch_retry([&ready](){
+        return ready;
+    }, [&done](){
+        done = true;
+    });
+    d.dispatch([](){});
+    d.dispatch([](){});
+    d.dispatch([](){});
+
+    // park the task and schedule the next check
+    d.process_one();
+    d.process_one();
+    ready = true;
+    d.process_one();
+    d.process_one();
+    ASSERT_FALSE(done);
+
+    d.retry_waiting();
+    d.process_one();
+    ASSERT_TRUE(done);
+}
+
+TEST(dispatcher, waiting_task_interrupted) {
+
+    dispatcher d;
+    connection c;
+
+    auto f = d.dispatch_retry(c, [](){
+        return false;
+    }, [](){
+        return 1;
+    });
+
+    d.process_one();
+    c.interrupt();
+    d.process_one();
+
+    ASSERT_THROW(f.get(), connection_interrupted);
+}
+
+TEST(dispatcher, dispatch_range) {
+
+    dispatcher d;
+    std::vector<int> values = { 1, 2, 3, 4 };
+
+    auto fs = d.dispatch_range(values.begin(), values.end(), [](int i){
+        return i*2;
+    });
+
+    ASSERT_EQ(values.size(), fs.size());
+    d.process_all();
+    for(size_t i=0; i<fs.size(); ++i)
+    {
+        ASSERT_EQ(values[i]*2, fs[i].get());
+    }
+}
+
+TEST(dispatcher, dispatch_bulk) {
+
+    dispatcher d;
+    connection c;
+    std::vector<size_t> indices;
+
+    auto fs = d.dispatch_bulk(c, 3, [&indices](size_t i){
+        indices.push_back(i);
+    });
+    d.process_one();
+    c.interrupt();
+    d.process_all();
+
+    ASSERT_EQ(1u, indices.size());
+    ASSERT_EQ(0u, indices[0]);
+    fs[0].get();
+    ASSERT_THROW(fs[1].get(), connection_interrupted);
+    ASSERT_THROW(fs[2].get(), connection_interrupted);
+}
+
+TEST(dispatcher, when_all_vector) {
+
+    dispatcher d;
+    int count = 0;
+
+    auto f = d.when_all(d.dispatch_bulk(4, [](size_t i){
+        return (int)i;
+    }));
+    auto f2 = d.when_all(d.dispatch_bulk(4, [&count](size_t i){
+        count++;
+    }));
+
+    d.process_all();
+
+    auto r = f.get();
+    ASSERT_EQ(4u, r.size());
+    ASSERT_EQ(0, r[0]);
+    ASSERT_EQ(3, r[3]);
+    f2.get();
+    ASSERT_EQ(4, count);
+}
+
+TEST(dispatcher, dispatch_priority) {
+
+    dispatcher d;
+    std::vector<int> order;
+
+    d.dispatch(task_priority::low, [&order](){
+        order.push_back(1);
+    });
+    d.dispatch([&order](){
+        order.push_back(2);
+    });
+    connection c;
+    auto f = d.dispatch(task_priority::high, c, [&order](int i){
+        order.push_back(i);
+        return i;
+    }, 3);
+
+    d.process_all();
+
+    ASSERT_EQ(3, f.get());
+    ASSERT_EQ(3u, order.size());
+    ASSERT_EQ(3, order[0]);
+    ASSERT_EQ(2, order[1]);
+    ASSERT_EQ(1, order[2]);
+}
+
+TEST(dispatcher, dispatch_after) {
+
+    dispatcher d;
+    auto start = dispatcher::clock::now();
+
+    auto f = d.dispatch_after(std::chrono::milliseconds(20), [](int i){
+        return i;
+    }, 5);
+    auto f2 = d.dispatch_at(start + std::chrono::milliseconds(10), [](){
+        return 1;
+    });
+
+    ASSERT_FALSE(d.process_one());
+    while(!when_worker::is_ready(f))
+    {
+        d.process_one();
+    }
+
+    ASSERT_EQ(5, f.get());
+    ASSERT_EQ(1, f2.get());
+    ASSERT_LE(std::chrono::milliseconds(20), dispatcher::clock::now() - start);
+}
+
+TEST(dispatcher, dispatch_after_interrupted) {
+
+    dispatcher d;
+    connection c;
+
+    auto f = d.dispatch_after(std::chrono::milliseconds(1), c, [](){
+        return 1;
+    });
+    c.interrupt();
+    while(!when_worker::is_ready(f))
+    {
+        d.process_one();
+    }
+
+    ASSERT_THROW(f.get(), connection_interrupted);
+}
+
+TEST(dispatcher, dispatch_every) {
+
+    dispatcher d;
+    connection c;
+    int count = 0;
+
+    auto f = d.dispatch_every(std::chrono::milliseconds(1), c, [&count, &c](int max){
+        if(++count == max)
+        {
+            c.interrupt();
+        }
+    }, 3);
+
+    while(!when_worker::is_ready(f))
+    {
+        d.process_one();
+    }
+
+    ASSERT_EQ(3, count);
+    ASSERT_THROW(f.get(), connection_interrupted);
+}
+
+TEST(dispatcher, dispatch_every_exception) {
+
+    dispatcher d;
+    connection c;
+
+    auto f = d.dispatch_every(std::chrono::milliseconds(1), c, [](){
+        throw std::runtime_error("error");
+    });
+
+    while(!when_worker::is_ready(f))
+    {
+        d.process_one();
+    }
+
+    ASSERT_THROW(f.get(), std::runtime_error);
+}
+
+TEST(dispatcher, null_connection) {
+
+    dispatcher d;
+    null_connection c;
+    int count = 0;
+
+    auto f1 = d.when_any(c, [](int a){
+        return a;
+    }, d.dispatch(c, [](){
+        return 1;
+    }), d.dispatch(c, [](){
+        return 1;
+    }));
+    auto f2 = d.when_every(c, [](const std::vector<int>&){
+    }, d.dispatch(c, [](){
+        return 2;
+    }), d.dispatch(c, [](){
+        return 2;
+    }));
+    std::vector<future<int>> fs;
+    fs.push_back(d.dispatch(c, [](){
+        return 3;
+    }));
+    auto f3 = d.when_each(c, [](size_t, int&){
+    }, std::move(fs));
+    auto f4 = d.dispatch_every(std::chrono::milliseconds(1), c, [&count](){
+        if(++count == 2)
+        {
+            throw std::runtime_error("stop");
+        }
+    });
+
+    while(!when_worker::is_ready(f4))
+    {
+        d.process_one();
+    }
+
+    ASSERT_EQ(1, f1.get());
+    ASSERT_EQ((std::vector<int>{ 2, 2 }), f2.get());
+    ASSERT_EQ(std::vector<int>{ 3 }, f3.get());
+    ASSERT_EQ(2, count);
+    ASSERT_THROW(f4.get(), std::runtime_error);
+}
+
+TEST(dispatcher, process_for) {
+
+    dispatcher d;
+    ASSERT_EQ(0u, d.process_for(std::chrono::milliseconds(10)).processed);
+
+    for(int i=0; i<10; ++i)
+    {
+        d.dispatch([](){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto report = d.process_for(std::chrono::milliseconds(22));
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    ASSERT_LE(2u, report.processed);
+    ASSERT_GE(4u, report.processed);
+    ASSERT_EQ(10u, report.processed + report.remaining);
+    ASSERT_LE(std::chrono::milliseconds(4), d.get_task_cost());
+    // the task cost is known, so the next call stops before overrunning
+    start = std::chrono::steady_clock::now();
+    report = d.process_for(std::chrono::milliseconds(12));
+    elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_GE(2u, report.processed);
+    ASSERT_GT(std::chrono::milliseconds(12), elapsed);
+}
+
+TEST(dispatcher, process_until_waiting) {
+
+    dispatcher d;
+    d.dispatch_retry([](){
+        return false;
+    }, [](){});
+    d.dispatch([](){});
+
+    // does not spin on the task that is never ready
+    auto start = std::chrono::steady_clock::now();
+    auto report = d.process_until(start + std::chrono::seconds(1));
+    ASSERT_EQ(1u, report.processed);
+    ASSERT_EQ(0u, report.remaining);
+    ASSERT_GT(std::chrono::milliseconds(100), std::chrono::steady_clock::now() - start);
+}
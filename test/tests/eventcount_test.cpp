@@ -0,0 +1,102 @@
+#include <eventually/eventcount.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+TEST(eventcount, notify) {
+
+    eventcount ec;
+    std::atomic<bool> ready(false);
+
+    std::thread t([&ec, &ready](){
+        while(!ready.load())
+        {
+            auto key = ec.prepare_wait();
+            if(ready.load())
+            {
+                ec.cancel_wait();
+                break;
+            }
+            ec.commit_wait(key);
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ready.store(true);
+    ec.notify();
+    t.join();
+
+    ASSERT_EQ(0u, ec.get_waiters());
+}
+
+TEST(eventcount, notify_before_commit) {
+
+    eventcount ec;
+
+    // a notify between prepare and commit is not lost
+    auto key = ec.prepare_wait();
+    ec.notify();
+    ec.commit_wait(key);
+
+    ASSERT_EQ(0u, ec.get_waiters());
+}
+
+TEST(eventcount, timeout) {
+
+    eventcount ec;
+    auto start = eventcount::clock::now();
+
+    auto key = ec.prepare_wait();
+    ec.commit_wait(key, start + std::chrono::milliseconds(10));
+
+    ASSERT_LE(std::chrono::milliseconds(10), eventcount::clock::now() - start);
+    ASSERT_EQ(0u, ec.get_waiters());
+}
+
+TEST(eventcount, many_waiters) {
+
+    eventcount ec;
+    std::atomic<int> items(0);
+    std::atomic<int> taken(0);
+    const int total = 10000;
+    std::vector<std::thread> threads;
+
+    for(int i=0; i<4; ++i)
+    {
+        threads.push_back(std::thread([&ec, &items, &taken, total](){
+            while(taken.load() < total)
+            {
+                int n = items.load();
+                if(n > 0 && items.compare_exchange_weak(n, n-1))
+                {
+                    taken++;
+                    continue;
+                }
+                auto key = ec.prepare_wait();
+                if(items.load() > 0 || taken.load() >= total)
+                {
+                    ec.cancel_wait();
+                    continue;
+                }
+                ec.commit_wait(key);
+            }
+            ec.notify_all();
+        }));
+    }
+
+    for(int i=0; i<total; ++i)
+    {
+        items++;
+        ec.notify();
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+
+    ASSERT_EQ(total, taken.load());
+}
@@ -0,0 +1,227 @@
+#include <eventually/future.hpp>
+#include <eventually/task.hpp>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+TEST(future, completion_then) {
+
+    future_completion c;
+    int called = 0;
+    c.then([&called](){
+        called++;
+    });
+
+    ASSERT_EQ(0, called);
+    c.done();
+    ASSERT_EQ(1, called);
+    c.done();
+    ASSERT_EQ(1, called);
+
+    c.then([&called](){
+        called++;
+    });
+    ASSERT_EQ(2, called);
+}
+
+TEST(future, completion_guard) {
+
+    int called = 0;
+    {
+        future_completion_guard g;
+        g.get()->then([&called](){
+            called++;
+        });
+    }
+    ASSERT_EQ(1, called);
+}
+
+TEST(future, std_future) {
+
+    std::promise<int> p;
+    future<int> f(p.get_future());
+    ASSERT_FALSE(f.get_completion());
+    p.set_value(3);
+
+    std::future<int> sf(std::move(f));
+    ASSERT_EQ(3, sf.get());
+}
+
+TEST(future, promise) {
+
+    promise<std::string> p;
+    auto f = p.get_future();
+    ASSERT_TRUE(f.valid());
+    ASSERT_FALSE(f.is_ready());
+    ASSERT_EQ(std::future_status::timeout, f.wait_for(std::chrono::milliseconds(1)));
+    p.set_value("test");
+
+    ASSERT_TRUE(f.is_ready());
+    ASSERT_EQ("test", f.get());
+    ASSERT_FALSE(f.valid());
+}
+
+TEST(future, promise_exception) {
+
+    promise<void> p;
+    auto f = p.get_future();
+    p.set_exception(std::make_exception_ptr(std::runtime_error("test")));
+
+    ASSERT_TRUE(f.is_ready());
+    ASSERT_THROW(f.get(), std::runtime_error);
+}
+
+TEST(future, promise_broken) {
+
+    future<int> f;
+    {
+        promise<int> p;
+        f = p.get_future();
+    }
+
+    ASSERT_TRUE(f.is_ready());
+    ASSERT_THROW(f.get(), std::future_error);
+}
+
+TEST(future, then) {
+
+    promise<int> p;
+    auto f = p.get_future().then([](int i){
+        return i*2;
+    }).then([](int i){
+        return std::to_string(i);
+    });
+
+    ASSERT_FALSE(f.is_ready());
+    p.set_value(21);
+    ASSERT_EQ("42", f.get());
+}
+
+TEST(future, then_exception) {
+
+    promise<int> p;
+    bool called = false;
+    auto f = p.get_future().then([&called](int i){
+        called = true;
+    });
+    p.set_exception(std::make_exception_ptr(std::runtime_error("test")));
+
+    ASSERT_THROW(f.get(), std::runtime_error);
+    ASSERT_FALSE(called);
+}
+
+TEST(future, to_std_future) {
+
+    promise<int> p;
+    std::future<int> sf = p.get_future();
+    std::thread t([&p](){
+        p.set_value(5);
+    });
+
+    ASSERT_EQ(5, sf.get());
+    t.join();
+}
+
+TEST(future, wait_thread) {
+
+    promise<void> p;
+    auto f = p.get_future();
+    std::thread t([&p](){
+        p.set_value();
+    });
+
+    f.wait();
+    ASSERT_TRUE(f.is_ready());
+    f.get();
+    t.join();
+}
+
+TEST(future, wait_for_loop) {
+
+    promise<int> p;
+    auto f = p.get_future();
+    int timeouts = 0;
+    while(f.wait_for(std::chrono::microseconds(10)) != std::future_status::ready)
+    {
+        if(++timeouts == 100)
+        {
+            p.set_value(3);
+        }
+    }
+
+    ASSERT_EQ(100, timeouts);
+    ASSERT_EQ(3, f.get());
+}
+
+TEST(future, traits) {
+
+    ASSERT_TRUE((is_future<std::future<int>>::value));
+    ASSERT_TRUE((is_future<future<int>, std::future<float>>::value));
+    ASSERT_FALSE((is_future<future<int>&>::value));
+    ASSERT_FALSE((is_future<int>::value));
+    ASSERT_TRUE((std::is_same<future_result_t<future<float>>, float>::value));
+}
+
+TEST(future, task_completion) {
+
+    connection c;
+    auto t = make_task_ptr(c, [](){
+        return true;
+    }, [](){
+        return 4;
+    });
+
+    auto f = t->get_future();
+    bool completed = false;
+    f.get_completion()->then([&completed](){
+        completed = true;
+    });
+
+    ASSERT_FALSE(completed);
+    (*t)();
+    ASSERT_TRUE(completed);
+    ASSERT_EQ(4, f.get());
+}
+
+TEST(future, task_broken) {
+
+    connection c;
+    auto t = make_task_ptr(c, [](){
+        return true;
+    }, [](){
+        return 4;
+    });
+
+    auto f = t->get_future();
+    bool completed = false;
+    f.get_completion()->then([&completed](){
+        completed = true;
+    });
+
+    t.reset();
+    ASSERT_TRUE(completed);
+    ASSERT_THROW(f.get(), std::future_error);
+}
+
+TEST(future, interrupt) {
+
+    connection c;
+    auto t = make_task_ptr(c, [](){
+        return true;
+    }, [](){
+        return 4;
+    });
+
+    auto f = t->get_future().then([](int i){
+        return i+1;
+    });
+    f.interrupt();
+    (*t)();
+
+    ASSERT_TRUE(c.interrupted());
+    ASSERT_THROW(f.get(), connection_interrupted);
+}
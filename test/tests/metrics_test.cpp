@@ -0,0 +1,122 @@
+#include <eventually/metrics.hpp>
+#include <eventually/dispatcher.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+TEST(histogram, buckets) {
+
+    for(uint64_t v=0; v<histogram::sub_bucket_count; ++v)
+    {
+        ASSERT_EQ(v, histogram::get_bucket(v));
+    }
+    uint64_t values[] = { 16, 17, 33, 1000, 123456, 1ull << 40 };
+    for(auto v : values)
+    {
+        size_t bucket = histogram::get_bucket(v);
+        uint64_t low = histogram::get_bucket_value(bucket);
+        uint64_t high = histogram::get_bucket_value(bucket + 1);
+        ASSERT_LE(low, v);
+        ASSERT_GT(high, v);
+        // the error is less than 1/16
+        ASSERT_GE(low / 16, high - low);
+    }
+    ASSERT_EQ(histogram::bucket_count - 1, histogram::get_bucket(UINT64_MAX));
+}
+
+TEST(histogram, percentiles) {
+
+    histogram h;
+    for(uint64_t v=1; v<=1000; ++v)
+    {
+        h.record(v);
+    }
+    auto s = h.get_snapshot();
+    ASSERT_EQ(1000u, s.count);
+    ASSERT_EQ(500500u, s.sum);
+    ASSERT_EQ(1000u, s.max);
+    ASSERT_DOUBLE_EQ(500.5, s.get_mean());
+    ASSERT_NEAR(500.0, (double)s.get_percentile(0.5), 500.0/16);
+    ASSERT_NEAR(990.0, (double)s.get_percentile(0.99), 990.0/16);
+    ASSERT_EQ(1000u, s.get_percentile(1.0));
+    ASSERT_EQ(0u, histogram_snapshot().get_percentile(0.5));
+}
+
+TEST(histogram, threads) {
+
+    histogram h;
+    std::vector<std::thread> threads;
+    for(int i=0; i<4; ++i)
+    {
+        threads.push_back(std::thread([&h, i](){
+            for(uint64_t v=0; v<10000; ++v)
+            {
+                h.record(v * (i + 1));
+            }
+        }));
+    }
+    for(auto& t : threads)
+    {
+        t.join();
+    }
+    auto s = h.get_snapshot();
+    ASSERT_EQ(40000u, s.count);
+    ASSERT_EQ(9999u * 4, s.max);
+}
+
+TEST(dispatcher, metrics) {
+
+    dispatcher d;
+    d.dispatch([](){});
+    d.dispatch_retry([](){
+        return false;
+    }, [](){});
+    auto m = d.get_metrics();
+    ASSERT_EQ(2u, m.queue_size);
+    d.process_one();
+    d.process_one();
+    m = d.get_metrics();
+    ASSERT_EQ(0u, m.queue_size);
+    ASSERT_EQ(1u, m.waiting_size);
+
+#ifdef EVENTUALLY_METRICS
+    ASSERT_EQ(2u, m.pushed);
+    ASSERT_LE(2u, m.popped);
+    ASSERT_LE(1u, m.not_ready);
+    ASSERT_EQ(1u, m.run_time.count);
+    ASSERT_EQ(1u, m.wait_time.count);
+#else
+    ASSERT_EQ(0u, m.pushed);
+    ASSERT_EQ(0u, m.run_time.count);
+#endif
+}
+
+#ifdef EVENTUALLY_METRICS
+TEST(thread_dispatcher, metrics) {
+
+    thread_dispatcher::options opts;
+    opts.thread_count = 2;
+    opts.work_stealing = true;
+    thread_dispatcher d(opts);
+    auto f = d.dispatch([&d](){
+        // pushed to the worker deque
+        return d.dispatch([](){
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        });
+    });
+    f.get().get();
+    // the run time is recorded after the promise is set
+    auto m = d.get_metrics();
+    for(int i=0; i<1000 && m.run_time.count < 2; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        m = d.get_metrics();
+    }
+    ASSERT_EQ(2u, m.pushed);
+    ASSERT_EQ(2u, m.run_time.count);
+    ASSERT_LE(2000000u, m.run_time.max);
+}
+#endif
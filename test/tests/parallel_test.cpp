@@ -0,0 +1,169 @@
+#include <eventually/parallel.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+namespace {
+
+    /**
+     * Destroys the tasks without running them
+     */
+    class drop_task_queue : public task_queue
+    {
+    public:
+        void push(basic_task_ptr&& t) NOEXCEPT
+        {
+            t.reset();
+        }
+
+        bool pop(basic_task_ptr& t) NOEXCEPT
+        {
+            return false;
+        }
+    };
+
+}
+
+TEST(parallel, for_index) {
+
+    thread_dispatcher d(4);
+    std::vector<int> values(1000, 0);
+
+    parallel_for(d, 0, (int)values.size(), [&values](int i){
+        values[i] = i;
+    }, 16);
+
+    for(int i=0; i<(int)values.size(); ++i)
+    {
+        ASSERT_EQ(i, values[i]);
+    }
+}
+
+TEST(parallel, for_iterator) {
+
+    thread_dispatcher d(4);
+    std::vector<int> values(1000, 1);
+
+    parallel_for(d, values.begin(), values.end(), [](int& v){
+        v *= 3;
+    });
+
+    ASSERT_EQ(3000, std::accumulate(values.begin(), values.end(), 0));
+}
+
+TEST(parallel, for_plain_dispatcher) {
+
+    // the calling thread does all the work
+    dispatcher d;
+    std::atomic<int> count(0);
+
+    parallel_for(d, 0, 100, [&count](int i){
+        count++;
+    }, 7);
+
+    ASSERT_EQ(100, count.load());
+}
+
+TEST(parallel, for_empty) {
+
+    dispatcher d;
+    bool called = false;
+
+    parallel_for(d, 5, 5, [&called](int i){
+        called = true;
+    });
+
+    ASSERT_FALSE(called);
+}
+
+TEST(parallel, for_exception) {
+
+    thread_dispatcher d(2);
+
+    ASSERT_THROW(parallel_for(d, 0, 100, [](int i){
+        if(i == 50)
+        {
+            throw std::runtime_error("error");
+        }
+    }, 1), std::runtime_error);
+}
+
+TEST(parallel, for_dropped_tasks) {
+
+    dispatcher d(new drop_task_queue());
+    std::atomic<int> count(0);
+
+    // the calling thread does not wait for the dropped chunks
+    ASSERT_THROW(parallel_for(d, 0, 100, [&count](int i){
+        count++;
+    }, 1), std::future_error);
+    ASSERT_GT(100, count.load());
+}
+
+TEST(parallel, nested_for) {
+
+    thread_dispatcher::options opts;
+    opts.thread_count = 1;
+    opts.work_stealing = true;
+    thread_dispatcher d(opts);
+    std::atomic<int> count(0);
+
+    // the inner loops run inside a worker that has to help with its own tasks
+    parallel_for(d, 0, 4, [&d, &count](int i){
+        parallel_for(d, 0, 10, [&count](int j){
+            count++;
+        }, 1);
+    }, 1);
+
+    ASSERT_EQ(40, count.load());
+}
+
+TEST(parallel, transform) {
+
+    thread_dispatcher d(4);
+    std::vector<int> values(1000);
+    std::iota(values.begin(), values.end(), 0);
+    std::vector<int> results(values.size());
+
+    auto end = parallel_transform(d, values.begin(), values.end(), results.begin(), [](int v){
+        return v*2;
+    }, 10);
+
+    ASSERT_TRUE(end == results.end());
+    for(size_t i=0; i<values.size(); ++i)
+    {
+        ASSERT_EQ(values[i]*2, results[i]);
+    }
+}
+
+TEST(parallel, reduce) {
+
+    thread_dispatcher d(4);
+    std::vector<int> values(1001);
+    std::iota(values.begin(), values.end(), 0);
+
+    auto sum = parallel_reduce(d, values.begin(), values.end(), 5, [](int a, int b){
+        return a+b;
+    }, 10);
+
+    ASSERT_EQ(5+1000*1001/2, sum);
+}
+
+TEST(parallel, reduce_order) {
+
+    thread_dispatcher d(4);
+    std::vector<std::string> values = { "a", "b", "c", "d", "e", "f", "g" };
+
+    auto result = parallel_reduce(d, values.begin(), values.end(), std::string(">"),
+        [](const std::string& a, const std::string& b){
+        return a+b;
+    }, 2);
+
+    ASSERT_EQ(">abcdefg", result);
+}
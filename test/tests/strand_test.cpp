@@ -0,0 +1,156 @@
+#include <eventually/strand.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+TEST(strand, order) {
+
+    thread_dispatcher d(4);
+    strand s(d);
+    std::atomic<int> running(0);
+    std::atomic<int> overlaps(0);
+    std::vector<int> order;
+
+    std::vector<future<void>> fs;
+    for(int i=0; i<10000; ++i)
+    {
+        fs.push_back(s.dispatch([i, &running, &overlaps, &order](){
+            if(running.fetch_add(1) != 0)
+            {
+                overlaps++;
+            }
+            order.push_back(i);
+            running.fetch_sub(1);
+        }));
+    }
+    for(auto& f : fs)
+    {
+        f.get();
+    }
+
+    ASSERT_EQ(0, overlaps.load());
+    ASSERT_EQ(10000u, order.size());
+    for(int i=0; i<10000; ++i)
+    {
+        ASSERT_EQ(i, order[i]);
+    }
+}
+
+TEST(strand, when) {
+
+    thread_dispatcher d(2);
+    strand s(d);
+
+    auto f = s.when([](int c){
+        return 2.0f*c;
+    }, s.dispatch([](int a, int b){
+        return a+b;
+    }, 2, 3));
+
+    ASSERT_EQ(10.0f, f.get());
+}
+
+TEST(strand, many) {
+
+    thread_dispatcher d(4);
+    std::vector<std::unique_ptr<strand>> strands;
+    std::vector<int> counts(1000, 0);
+    std::vector<future<void>> fs;
+    for(size_t i=0; i<counts.size(); ++i)
+    {
+        strands.emplace_back(new strand(d, 8));
+    }
+    for(size_t j=0; j<100; ++j)
+    {
+        for(size_t i=0; i<counts.size(); ++i)
+        {
+            int* count = &counts[i];
+            fs.push_back(strands[i]->dispatch([count](){
+                (*count)++;
+            }));
+        }
+    }
+    for(auto& f : fs)
+    {
+        f.get();
+    }
+
+    for(auto count : counts)
+    {
+        ASSERT_EQ(100, count);
+    }
+}
+
+TEST(strand, dispatch_after) {
+
+    thread_dispatcher d(2);
+    strand s(d);
+
+    auto start = std::chrono::steady_clock::now();
+    auto f = s.dispatch_after(std::chrono::milliseconds(20), [](){
+        return 1;
+    });
+
+    ASSERT_EQ(1, f.get());
+    ASSERT_LE(std::chrono::milliseconds(20), std::chrono::steady_clock::now() - start);
+}
+
+TEST(strand, destroy) {
+
+    dispatcher d;
+    future<int> f;
+    {
+        strand s(d);
+        f = s.dispatch([](){
+            return 1;
+        });
+        ASSERT_TRUE(s.is_scheduled());
+    }
+
+    // the batch task of the destroyed strand does nothing
+    ASSERT_TRUE(d.process_one());
+    ASSERT_THROW(f.get(), std::future_error);
+}
+
+TEST(strand, process_one_scheduled) {
+
+    dispatcher d;
+    strand s(d);
+    int count = 0;
+    auto f = s.dispatch([&count](){
+        return ++count;
+    });
+
+    // the batch is dispatched to the target, so only the target runs the task
+    ASSERT_FALSE(s.process_one());
+    ASSERT_FALSE(s.process_all());
+    ASSERT_EQ(0, count);
+
+    ASSERT_TRUE(d.process_all());
+    ASSERT_EQ(1, f.get());
+    ASSERT_FALSE(s.is_scheduled());
+}
+
+TEST(strand, process_one_nested) {
+
+    dispatcher d;
+    strand s(d);
+    bool inner = false;
+    auto f = s.dispatch([&s, &inner](){
+        s.dispatch([&inner](){
+            inner = true;
+        });
+        // the outer task owns the strand
+        return s.process_one();
+    });
+
+    d.process_all();
+    ASSERT_TRUE(inner);
+    ASSERT_TRUE(f.get());
+}
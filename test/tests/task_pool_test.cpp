@@ -0,0 +1,48 @@
+#include <eventually/task_pool.hpp>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+TEST(task_pool, reuse_blocks) {
+
+    void* a = task_pool::allocate(40);
+    task_pool::deallocate(a, 40);
+    void* b = task_pool::allocate(48);
+    ASSERT_EQ(a, b);
+    task_pool::deallocate(b, 48);
+
+    void* big = task_pool::allocate(task_pool::max_size+1);
+    ASSERT_NE(nullptr, big);
+    task_pool::deallocate(big, task_pool::max_size+1);
+}
+
+TEST(task_pool, share_between_threads) {
+
+    const size_t size = 64;
+    const size_t n = task_pool::cache_size+task_pool::batch_size;
+    std::vector<void*> blocks;
+    std::thread t([&blocks, n, size](){
+        for(size_t i=0; i<n; ++i)
+        {
+            blocks.push_back(task_pool::allocate(size));
+        }
+    });
+    t.join();
+    for(auto p : blocks)
+    {
+        task_pool::deallocate(p, size);
+    }
+
+    // the blocks freed here have to be usable by other threads
+    size_t reused = 0;
+    std::thread t2([&blocks, &reused, size](){
+        void* p = task_pool::allocate(size);
+        reused = std::count(blocks.begin(), blocks.end(), p);
+        task_pool::deallocate(p, size);
+    });
+    t2.join();
+    ASSERT_EQ(1u, reused);
+}
@@ -0,0 +1,291 @@
+#include <eventually/task_queue.hpp>
+#include <eventually/dispatcher.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+namespace {
+
+    basic_task_ptr make_counter_task(std::atomic<int>& counter)
+    {
+        connection c;
+        return basic_task_ptr(make_task_ptr(c, [](){
+            return true;
+        }, [&counter](){
+            counter++;
+        }));
+    }
+
+    void run_all(task_queue& q)
+    {
+        basic_task_ptr t;
+        while(q.pop(t))
+        {
+            (*t)();
+        }
+    }
+
+}
+
+TEST(task_queue, locked_fifo) {
+
+    locked_task_queue q;
+    std::vector<int> order;
+    for(int i=0; i<3; ++i)
+    {
+        connection c;
+        q.push(basic_task_ptr(make_task_ptr(c, [](){
+            return true;
+        }, [&order, i](){
+            order.push_back(i);
+        })));
+    }
+
+    run_all(q);
+
+    ASSERT_EQ(3, (int)order.size());
+    ASSERT_EQ(0, order[0]);
+    ASSERT_EQ(1, order[1]);
+    ASSERT_EQ(2, order[2]);
+}
+
+TEST(task_queue, push_list) {
+
+    locked_task_queue lq;
+    lockfree_task_queue fq(8);
+    std::atomic<int> counter(0);
+    for(task_queue* q : std::vector<task_queue*>{ &lq, &fq })
+    {
+        std::vector<basic_task_ptr> ts;
+        for(int i=0; i<5; ++i)
+        {
+            ts.push_back(make_counter_task(counter));
+        }
+        q->push(std::move(ts));
+        ASSERT_TRUE(ts.empty());
+        run_all(*q);
+    }
+
+    ASSERT_EQ(10, counter.load());
+}
+
+TEST(task_queue, priority_order) {
+
+    priority_task_queue q;
+    std::vector<int> order;
+    task_priority priorities[] = {
+        task_priority::low, task_priority::normal,
+        task_priority::high, task_priority::normal
+    };
+    for(int i=0; i<4; ++i)
+    {
+        connection c;
+        auto t = make_task_ptr(c, [](){
+            return true;
+        }, [&order, i](){
+            order.push_back(i);
+        });
+        t->set_priority(priorities[i]);
+        q.push(std::move(t));
+    }
+
+    run_all(q);
+
+    ASSERT_EQ(4, (int)order.size());
+    ASSERT_EQ(2, order[0]);
+    ASSERT_EQ(1, order[1]);
+    ASSERT_EQ(3, order[2]);
+    ASSERT_EQ(0, order[3]);
+}
+
+TEST(task_queue, priority_aging) {
+
+    priority_task_queue q(std::chrono::milliseconds(1));
+    std::vector<int> order;
+    auto push = [&q, &order](int i, task_priority p){
+        connection c;
+        auto t = make_task_ptr(c, [](){
+            return true;
+        }, [&order, i](){
+            order.push_back(i);
+        });
+        t->set_priority(p);
+        q.push(std::move(t));
+    };
+
+    push(0, task_priority::low);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    push(1, task_priority::high);
+    push(2, task_priority::high);
+
+    run_all(q);
+
+    // the low priority task waited longer than the aging time
+    ASSERT_EQ(3, (int)order.size());
+    ASSERT_EQ(0, order[0]);
+    ASSERT_EQ(1, order[1]);
+    ASSERT_EQ(2, order[2]);
+}
+
+TEST(task_queue, lockfree_fifo) {
+
+    lockfree_task_queue q(4);
+    std::vector<int> order;
+
+    // go around the ring a couple of times
+    for(int i=0; i<10; ++i)
+    {
+        connection c;
+        q.push(basic_task_ptr(make_task_ptr(c, [](){
+            return true;
+        }, [&order, i](){
+            order.push_back(i);
+        })));
+        run_all(q);
+    }
+
+    ASSERT_EQ(10, (int)order.size());
+    for(int i=0; i<10; ++i)
+    {
+        ASSERT_EQ(i, order[i]);
+    }
+}
+
+TEST(task_queue, lockfree_full) {
+
+    lockfree_task_queue q(2);
+    std::atomic<int> counter(0);
+
+    ASSERT_EQ(2, (int)q.capacity());
+
+    basic_task_ptr t1 = make_counter_task(counter);
+    basic_task_ptr t2 = make_counter_task(counter);
+    basic_task_ptr t3 = make_counter_task(counter);
+    ASSERT_TRUE(q.try_push(t1));
+    ASSERT_TRUE(q.try_push(t2));
+    ASSERT_FALSE(q.try_push(t3));
+    ASSERT_TRUE(t3 != nullptr);
+
+    run_all(q);
+    ASSERT_EQ(2, counter.load());
+}
+
+TEST(task_queue, lockfree_overflow) {
+
+    dispatcher d(new lockfree_task_queue(4));
+    std::vector<int> order;
+
+    // the thread that fills the queue is the one that processes it
+    for(int i=0; i<100; ++i)
+    {
+        d.dispatch([&order, i](){
+            order.push_back(i);
+        });
+    }
+    d.process_all();
+
+    ASSERT_EQ(100, (int)order.size());
+    for(int i=0; i<100; ++i)
+    {
+        ASSERT_EQ(i, order[i]);
+    }
+}
+
+TEST(task_queue, lockfree_threads) {
+
+    lockfree_task_queue q(64);
+    std::atomic<int> counter(0);
+    std::atomic<bool> done(false);
+    const int producers = 4;
+    const int tasks = 1000;
+
+    std::vector<std::thread> threads;
+    for(int i=0; i<producers; ++i)
+    {
+        threads.push_back(std::thread([&q, &counter](){
+            for(int j=0; j<tasks; ++j)
+            {
+                q.push(make_counter_task(counter));
+            }
+        }));
+    }
+    std::thread consumer([&q, &done](){
+        while(!done.load())
+        {
+            run_all(q);
+            std::this_thread::yield();
+        }
+        run_all(q);
+    });
+
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    done.store(true);
+    consumer.join();
+
+    ASSERT_EQ(producers*tasks, counter.load());
+}
+
+TEST(task_queue, lockfree_dispatcher) {
+
+    dispatcher d(new lockfree_task_queue());
+
+    auto f = d.when([](int c){
+        return 2.0f*c ;
+    }, d.dispatch([](int a, int b){
+        return a+b;
+    }, 2, 3));
+
+    d.process_all();
+
+    ASSERT_FLOAT_EQ(10.0f, f.get());
+}
+
+TEST(task_queue, lockfree_thread_dispatcher) {
+
+    thread_dispatcher d(new lockfree_task_queue());
+
+    auto f = d.when([](int c){
+        return 2.0f*c ;
+    }, d.dispatch([](int a, int b){
+        return a+b;
+    }, 2, 3));
+
+    ASSERT_FLOAT_EQ(10.0f, f.get());
+}
+
+TEST(task_queue, purge) {
+
+    locked_task_queue lq;
+    lockfree_task_queue fq(8);
+    priority_task_queue pq;
+    std::vector<task_queue*> queues = { &lq, &fq, &pq };
+    for(auto q : queues)
+    {
+        std::atomic<int> counter(0);
+        connection c;
+        for(int i=0; i<4; ++i)
+        {
+            connection tc = i % 2 ? c.child() : connection();
+            q->push(basic_task_ptr(make_task_ptr(tc, [](){
+                return true;
+            }, [&counter](){
+                counter++;
+            })));
+        }
+        c.interrupt();
+
+        std::vector<basic_task_ptr> purged;
+        ASSERT_EQ(2u, q->purge(purged));
+        ASSERT_EQ(2u, purged.size());
+        run_all(*q);
+        ASSERT_EQ(2, counter.load());
+    }
+}
@@ -1,7 +1,15 @@
 
 #include <eventually/thread_dispatcher.hpp>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
 #include "gtest/gtest.h"
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
 using namespace eventually;
 
 TEST(thread_dispatcher, process) {
@@ -78,6 +86,145 @@ TEST(thread_dispatcher, when_combined_scoped_connection) {
     }
 }
 
+TEST(thread_dispatcher, work_stealing) {
+
+    thread_dispatcher::options opts;
+    opts.work_stealing = true;
+    thread_dispatcher d(opts);
+
+    auto future = d.when([](int c){
+        return 2.0f*c ;
+    }, d.dispatch([](int a, int b){
+        return a+b;
+    }, 2, 3));
+
+    ASSERT_FLOAT_EQ(10.0f, future.get());
+}
+
+TEST(thread_dispatcher, work_stealing_lifo) {
+
+    thread_dispatcher::options opts;
+    opts.thread_count = 1;
+    opts.work_stealing = true;
+    thread_dispatcher d(opts);
+    std::vector<int> order;
+    std::atomic<int> done(0);
+
+    // the only worker runs the tasks it dispatched newest first
+    d.dispatch([&d, &order, &done](){
+        for(int i=0; i<3; ++i)
+        {
+            d.dispatch([&order, &done, i](){
+                order.push_back(i);
+                done++;
+            });
+        }
+    });
+
+    while(done.load() < 3)
+    {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ((std::vector<int>{ 2, 1, 0 }), order);
+}
+
+TEST(thread_dispatcher, work_stealing_fan_out) {
+
+    thread_dispatcher::options opts;
+    opts.work_stealing = true;
+    opts.thread_count = 4;
+    thread_dispatcher d(opts);
+    std::atomic<int> leaves(0);
+    const int depth = 10;
+
+    std::function<void(int)> fan_out = [&d, &leaves, &fan_out](int level){
+        if(level == 0)
+        {
+            leaves++;
+            return;
+        }
+        d.dispatch(fan_out, level-1);
+        d.dispatch(fan_out, level-1);
+    };
+
+    d.dispatch(fan_out, depth);
+
+    while(leaves.load() < (1 << depth))
+    {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(1 << depth, leaves.load());
+}
+
+TEST(thread_dispatcher, work_stealing_when_inside_task) {
+
+    thread_dispatcher::options opts;
+    opts.work_stealing = true;
+    thread_dispatcher d(opts);
+
+    auto f = d.dispatch([&d](){
+        return d.when_every(d.dispatch([](){
+            return 1;
+        }), d.dispatch([](){
+            return 2;
+        }));
+    });
+
+    auto r = f.get().get();
+    ASSERT_EQ(2, (int)r.size());
+    ASSERT_EQ(3, r[0]+r[1]);
+}
+
+TEST(thread_dispatcher, never_ready_task) {
+
+    thread_dispatcher d;
+    const int tasks = 10000;
+    std::atomic<bool> done(false);
+
+    d.dispatch_retry([&done](){
+        return done.load();
+    }, [](){
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<future<int>> fs;
+    fs.reserve(tasks);
+    for(int i=0; i<tasks; ++i)
+    {
+        fs.push_back(d.dispatch([i](){
+            return i;
+        }));
+    }
+    for(int i=0; i<tasks; ++i)
+    {
+        ASSERT_EQ(i, fs[i].get());
+    }
+    auto duration = std::chrono::steady_clock::now() - start;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+    RecordProperty("completion_ms", (int)ms);
+    done.store(true);
+
+    ASSERT_GT(5000, ms);
+}
+
+TEST(thread_dispatcher, dispatch_bulk) {
+
+    thread_dispatcher::options opts;
+    for(bool ws : { false, true })
+    {
+        opts.work_stealing = ws;
+        thread_dispatcher d(opts);
+        std::atomic<int> sum(0);
+
+        auto f = d.when_all(d.dispatch_bulk(1000, [&sum](size_t i){
+            sum += (int)i;
+        }));
+        f.get();
+
+        ASSERT_EQ(999*1000/2, sum.load());
+    }
+}
+
 /*
 TEST(thread_dispatcher, race_condition) {
     int var;
@@ -90,4 +237,248 @@ TEST(thread_dispatcher, race_condition) {
         var++;
     });
 }
-*/
\ No newline at end of file
+*/
+TEST(thread_dispatcher, dispatch_after) {
+
+    thread_dispatcher d(2);
+    auto start = thread_dispatcher::clock::now();
+
+    // the workers sleep until the timer
+    auto f = d.dispatch_after(std::chrono::milliseconds(30), [start](){
+        return thread_dispatcher::clock::now() - start;
+    });
+
+    auto elapsed = f.get();
+    ASSERT_LE(std::chrono::milliseconds(30), elapsed);
+    ASSERT_GT(std::chrono::milliseconds(1000), elapsed);
+}
+
+TEST(thread_dispatcher, no_lost_wakeups) {
+
+    thread_dispatcher::options opts;
+    opts.thread_count = 2;
+    opts.spin_count = 0;
+    thread_dispatcher d(opts);
+
+    // every task is dispatched when the workers are about to sleep
+    for(int i=0; i<2000; ++i)
+    {
+        auto f = d.dispatch([i](){
+            return i;
+        });
+        ASSERT_EQ(std::future_status::ready, f.wait_for(std::chrono::seconds(5)));
+        ASSERT_EQ(i, f.get());
+    }
+}
+
+TEST(thread_dispatcher, sleep_with_waiting_task) {
+
+    thread_dispatcher d(1);
+    std::atomic<int> retries(0);
+    std::atomic<bool> ready(false);
+
+    auto f = d.dispatch_retry([&retries, &ready](){
+        retries++;
+        return ready.load();
+    }, [](){
+        return 1;
+    });
+
+    // the worker sleeps for the retry interval between checks
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ready.store(true);
+
+    ASSERT_EQ(1, f.get());
+    RecordProperty("retries", retries.load());
+    ASSERT_GT(50000, retries.load());
+}
+
+TEST(thread_dispatcher, elastic_grow) {
+
+    std::atomic<size_t> resized(0);
+    thread_dispatcher::options opts;
+    opts.thread_count = 1;
+    opts.max_thread_count = 4;
+    opts.grow_backlog = 2;
+    opts.on_resize = [&resized](size_t count){
+        resized.store(count);
+    };
+    thread_dispatcher d(opts);
+    ASSERT_EQ(1u, d.get_thread_count());
+
+    // blocked tasks fill the queue until the pool grows
+    std::atomic<bool> release(false);
+    std::vector<future<void>> fs;
+    for(int i=0; i<20; ++i)
+    {
+        fs.push_back(d.dispatch([&release](){
+            while(!release.load())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }));
+    }
+    ASSERT_EQ(4u, d.get_thread_count());
+    ASSERT_EQ(4u, resized.load());
+    release.store(true);
+    for(auto& f : fs)
+    {
+        f.get();
+    }
+}
+
+TEST(thread_dispatcher, elastic_shrink) {
+
+    std::atomic<size_t> resized(0);
+    thread_dispatcher::options opts;
+    opts.thread_count = 4;
+    opts.min_thread_count = 1;
+    opts.idle_timeout = std::chrono::milliseconds(10);
+    opts.on_resize = [&resized](size_t count){
+        resized.store(count);
+    };
+    thread_dispatcher d(opts);
+    ASSERT_EQ(4u, d.get_thread_count());
+
+    auto start = std::chrono::steady_clock::now();
+    while(d.get_thread_count() > 1 && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(1u, d.get_thread_count());
+    ASSERT_EQ(1u, resized.load());
+
+    auto f = d.dispatch([](){
+        return 1;
+    });
+    ASSERT_EQ(1, f.get());
+}
+
+TEST(thread_dispatcher, elastic_from_zero) {
+
+    thread_dispatcher::options opts;
+    opts.thread_count = 0;
+    opts.max_thread_count = 2;
+    opts.idle_timeout = std::chrono::milliseconds(10);
+    thread_dispatcher d(opts);
+    ASSERT_EQ(0u, d.get_thread_count());
+
+    for(int i=0; i<3; ++i)
+    {
+        // a task or a timer starts a thread when there are none
+        auto f1 = d.dispatch([i](){
+            return i;
+        });
+        ASSERT_EQ(i, f1.get());
+        auto f2 = d.dispatch_after(std::chrono::milliseconds(20), [i](){
+            return i;
+        });
+        ASSERT_EQ(i, f2.get());
+
+        auto start = std::chrono::steady_clock::now();
+        while(d.get_thread_count() > 0 && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_EQ(0u, d.get_thread_count());
+    }
+}
+
+TEST(thread_dispatcher, purge_interrupted) {
+
+    // the lock free queue purges by popping every task and pushing back the rest
+    thread_dispatcher d(new lockfree_task_queue(), 2);
+
+    for(int i=0; i<50; ++i)
+    {
+        connection c;
+        std::vector<future<int>> kept;
+        for(int j=0; j<200; ++j)
+        {
+            d.dispatch(c, [](){
+                return 0;
+            });
+            kept.push_back(d.dispatch([j](){
+                return j;
+            }));
+        }
+        c.interrupt();
+        d.purge_interrupted();
+
+        // the workers that found the queue empty while purging are woken up
+        for(int j=0; j<200; ++j)
+        {
+            ASSERT_EQ(std::future_status::ready, kept[j].wait_for(std::chrono::seconds(5)));
+            ASSERT_EQ(j, kept[j].get());
+        }
+    }
+}
+
+TEST(thread_dispatcher, blocking_scope) {
+
+    thread_dispatcher::options opts;
+    opts.thread_count = 1;
+    opts.max_blocking_thread_count = 1;
+    thread_dispatcher d(opts);
+    std::atomic<bool> release(false);
+
+    // the only thread blocks until another task runs
+    auto f1 = d.dispatch([&d, &release](){
+        blocking_scope blocking;
+        blocking_scope nested;
+        size_t count = d.get_blocking_count();
+        while(!release.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return count;
+    });
+    auto f2 = d.dispatch([&release](){
+        release.store(true);
+    });
+    ASSERT_EQ(std::future_status::ready, f2.wait_for(std::chrono::seconds(5)));
+    ASSERT_EQ(1u, f1.get());
+    ASSERT_EQ(0u, d.get_blocking_count());
+    ASSERT_EQ(2u, d.get_thread_count());
+
+    {
+        // outside of the dispatcher threads it does nothing
+        blocking_scope blocking;
+        ASSERT_EQ(0u, d.get_blocking_count());
+    }
+}
+
+TEST(thread_dispatcher, blocking_scope_default) {
+
+    // by default blocking tasks do not add threads
+    thread_dispatcher d(1);
+    auto f = d.dispatch([](){
+        blocking_scope blocking;
+    });
+    f.get();
+
+    ASSERT_EQ(1u, d.get_thread_count());
+}
+
+#if defined(__linux__)
+TEST(thread_dispatcher, pin_threads) {
+
+    thread_dispatcher::options opts;
+    opts.thread_count = 2;
+    opts.cpu_set = { 0 };
+    opts.pin_threads = true;
+    opts.numa = true;
+    thread_dispatcher d(opts);
+
+    std::promise<int> inner;
+    auto f = d.dispatch([&d, &inner](){
+        // tasks dispatched from a thread go to the queue of its node
+        d.dispatch([&inner](){
+            inner.set_value(sched_getcpu());
+        });
+        return sched_getcpu();
+    });
+    ASSERT_EQ(0, f.get());
+    ASSERT_EQ(0, inner.get_future().get());
+}
+#endif
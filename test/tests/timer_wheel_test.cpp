@@ -0,0 +1,165 @@
+#include <eventually/timer_wheel.hpp>
+#include <algorithm>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+namespace {
+
+    /**
+     * A task that stores a number when run
+     */
+    class number_task : public basic_task
+    {
+    private:
+        std::vector<int>& _numbers;
+        int _number;
+    public:
+        number_task(std::vector<int>& numbers, int number):
+        _numbers(numbers), _number(number)
+        {
+        }
+
+        bool operator()()
+        {
+            _numbers.push_back(_number);
+            return true;
+        }
+    };
+
+    void add(timer_wheel& w, std::vector<int>& numbers, timer_wheel::tick t)
+    {
+        w.add(t, basic_task_ptr(new number_task(numbers, (int)t)));
+    }
+
+    void run(std::vector<basic_task_ptr>& tasks)
+    {
+        for(auto& t : tasks)
+        {
+            (*t)();
+        }
+        tasks.clear();
+    }
+
+}
+
+TEST(timer_wheel, expire_in_order) {
+
+    timer_wheel w;
+    std::vector<int> numbers;
+    std::vector<basic_task_ptr> expired;
+
+    add(w, numbers, 100);
+    add(w, numbers, 5);
+    add(w, numbers, 70000);
+    add(w, numbers, 64);
+    ASSERT_EQ(4u, w.size());
+
+    timer_wheel::tick next;
+    ASSERT_TRUE(w.next(next));
+    ASSERT_EQ(5u, next);
+
+    w.advance(4, expired);
+    ASSERT_TRUE(expired.empty());
+
+    w.advance(100, expired);
+    run(expired);
+    ASSERT_EQ(3u, numbers.size());
+    ASSERT_EQ(5, numbers[0]);
+    ASSERT_EQ(64, numbers[1]);
+    ASSERT_EQ(100, numbers[2]);
+
+    w.advance(69999, expired);
+    ASSERT_TRUE(expired.empty());
+    w.advance(70000, expired);
+    run(expired);
+    ASSERT_EQ(4u, numbers.size());
+    ASSERT_EQ(70000, numbers[3]);
+    ASSERT_TRUE(w.empty());
+    ASSERT_FALSE(w.next(next));
+}
+
+TEST(timer_wheel, past_ticks) {
+
+    timer_wheel w(1000);
+    std::vector<int> numbers;
+    std::vector<basic_task_ptr> expired;
+
+    add(w, numbers, 10);
+    w.advance(1000, expired);
+    ASSERT_TRUE(expired.empty());
+    w.advance(1001, expired);
+    ASSERT_EQ(1u, expired.size());
+}
+
+TEST(timer_wheel, many_timers) {
+
+    timer_wheel w;
+    std::vector<int> numbers;
+    std::vector<basic_task_ptr> expired;
+    std::vector<int> ticks;
+
+    for(int i=0; i<10000; ++i)
+    {
+        int t = (i * 7919) % 1000000 + 1;
+        ticks.push_back(t);
+        add(w, numbers, t);
+    }
+    std::sort(ticks.begin(), ticks.end());
+
+    timer_wheel::tick now = 0;
+    while(!w.empty())
+    {
+        now += 997;
+        w.advance(now, expired);
+        run(expired);
+    }
+
+    ASSERT_EQ(ticks, numbers);
+}
+
+TEST(timer_wheel, far_ticks) {
+
+    timer_wheel w;
+    std::vector<int> numbers;
+    std::vector<basic_task_ptr> expired;
+    timer_wheel::tick far = (timer_wheel::tick)1 << 40;
+
+    w.add(far, basic_task_ptr(new number_task(numbers, 1)));
+    timer_wheel::tick next = 0;
+    while(w.next(next) && next < far)
+    {
+        w.advance(next, expired);
+        ASSERT_TRUE(expired.empty());
+    }
+    w.advance(far, expired);
+    ASSERT_EQ(1u, expired.size());
+}
+
+TEST(timer_wheel, purge) {
+
+    timer_wheel w;
+    std::vector<int> numbers;
+    std::vector<basic_task_ptr> expired;
+    connection c;
+    for(int i=1; i<=4; ++i)
+    {
+        connection tc = i % 2 ? c : connection();
+        w.add(i*1000, basic_task_ptr(make_task_ptr(tc, [](){
+            return true;
+        }, [&numbers, i](){
+            numbers.push_back(i);
+        })));
+    }
+    c.interrupt();
+
+    std::vector<basic_task_ptr> purged;
+    ASSERT_EQ(2u, w.purge(purged));
+    ASSERT_EQ(2u, w.size());
+    w.advance(4000, expired);
+    run(expired);
+
+    std::vector<int> expected = { 2, 4 };
+    ASSERT_EQ(expected, numbers);
+}
@@ -0,0 +1,105 @@
+#include <eventually/tracer.hpp>
+#include <eventually/dispatcher.hpp>
+#include <eventually/thread_dispatcher.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+TEST(tracer, label) {
+
+    ASSERT_EQ(nullptr, trace_label::get_current());
+    {
+        trace_label a("a");
+        ASSERT_STREQ("a", trace_label::get_current());
+        {
+            trace_label b("b");
+            ASSERT_STREQ("b", trace_label::get_current());
+        }
+        ASSERT_STREQ("a", trace_label::get_current());
+    }
+    ASSERT_EQ(nullptr, trace_label::get_current());
+}
+
+TEST(tracer, links) {
+
+    tracer t;
+    task_trace parent;
+    parent.label = "parent \"quoted\"";
+    t.push(parent);
+    ASSERT_EQ(0u, parent.parent);
+
+    task_trace child;
+    {
+        tracer::run_scope scope(&t, parent);
+        // pushed while the parent runs
+        t.push(child);
+        scope.end(true);
+    }
+    ASSERT_EQ(parent.id, child.parent);
+    ASSERT_EQ(nullptr, child.label);
+    {
+        tracer::run_scope scope(&t, child);
+        scope.end(false);
+    }
+    ASSERT_EQ(3u, t.get_event_count());
+
+    std::ostringstream out;
+    t.write_json(out);
+    auto json = out.str();
+    ASSERT_NE(std::string::npos, json.find("\"name\":\"parent \\\"quoted\\\"\""));
+    ASSERT_NE(std::string::npos, json.find("\"ph\":\"s\",\"id\":" + std::to_string(child.id)));
+    ASSERT_NE(std::string::npos, json.find("\"ready\":false"));
+}
+
+TEST(tracer, ring_buffer) {
+
+    tracer t(8);
+    task_trace trace;
+    t.push(trace);
+    for(int i=0; i<20; ++i)
+    {
+        tracer::run_scope scope(&t, trace);
+        scope.end(true);
+    }
+    std::thread thread_([&t, &trace](){
+        tracer::run_scope scope(&t, trace);
+        scope.end(true);
+    });
+    thread_.join();
+    // the oldest events are overwritten
+    ASSERT_EQ(9u, t.get_event_count());
+    std::ostringstream out;
+    t.write_json(out);
+    ASSERT_NE(std::string::npos, out.str().find("\"tid\":2"));
+}
+
+#ifdef EVENTUALLY_TRACE
+TEST(dispatcher, tracer) {
+
+    tracer t;
+    dispatcher d;
+    d.set_tracer(&t);
+    future<int> f;
+    {
+        trace_label label("first");
+        f = d.dispatch([](){
+            return 1;
+        });
+    }
+    auto f2 = d.when([](int v){
+        return v + 1;
+    }, std::move(f));
+    d.process_all();
+    ASSERT_EQ(2, f2.get());
+
+    std::ostringstream out;
+    t.write_json(out);
+    auto json = out.str();
+    ASSERT_NE(std::string::npos, json.find("\"name\":\"first\""));
+    // the continuation is linked to the first task
+    ASSERT_NE(std::string::npos, json.find("\"ph\":\"f\""));
+}
+#endif
@@ -0,0 +1,145 @@
+#include <eventually/work_stealing_deque.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+using namespace eventually;
+
+namespace {
+
+    basic_task_ptr make_order_task(std::vector<int>& order, int i)
+    {
+        connection c;
+        return basic_task_ptr(make_task_ptr(c, [](){
+            return true;
+        }, [&order, i](){
+            order.push_back(i);
+        }));
+    }
+
+    basic_task_ptr make_counter_task(std::atomic<int>& counter)
+    {
+        connection c;
+        return basic_task_ptr(make_task_ptr(c, [](){
+            return true;
+        }, [&counter](){
+            counter++;
+        }));
+    }
+
+}
+
+TEST(work_stealing_deque, pop_lifo) {
+
+    work_stealing_deque q;
+    std::vector<int> order;
+    for(int i=0; i<3; ++i)
+    {
+        q.push(make_order_task(order, i));
+    }
+
+    basic_task_ptr t;
+    while(q.pop(t))
+    {
+        (*t)();
+    }
+
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(3, (int)order.size());
+    ASSERT_EQ(2, order[0]);
+    ASSERT_EQ(1, order[1]);
+    ASSERT_EQ(0, order[2]);
+}
+
+TEST(work_stealing_deque, steal_fifo) {
+
+    work_stealing_deque q;
+    std::vector<int> order;
+    for(int i=0; i<3; ++i)
+    {
+        q.push(make_order_task(order, i));
+    }
+
+    basic_task_ptr t;
+    while(q.steal(t))
+    {
+        (*t)();
+    }
+
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(3, (int)order.size());
+    ASSERT_EQ(0, order[0]);
+    ASSERT_EQ(1, order[1]);
+    ASSERT_EQ(2, order[2]);
+}
+
+TEST(work_stealing_deque, grow) {
+
+    work_stealing_deque q(2);
+    std::vector<int> order;
+    for(int i=0; i<100; ++i)
+    {
+        q.push(make_order_task(order, i));
+    }
+
+    basic_task_ptr t;
+    while(q.steal(t))
+    {
+        (*t)();
+    }
+
+    ASSERT_EQ(100, (int)order.size());
+    for(int i=0; i<100; ++i)
+    {
+        ASSERT_EQ(i, order[i]);
+    }
+}
+
+TEST(work_stealing_deque, thieves) {
+
+    work_stealing_deque q(16);
+    std::atomic<int> counter(0);
+    std::atomic<bool> done(false);
+    const int tasks = 10000;
+
+    std::vector<std::thread> thieves;
+    for(int i=0; i<3; ++i)
+    {
+        thieves.push_back(std::thread([&q, &done](){
+            basic_task_ptr t;
+            while(!done.load())
+            {
+                if(q.steal(t))
+                {
+                    (*t)();
+                }
+            }
+        }));
+    }
+
+    basic_task_ptr t;
+    for(int i=0; i<tasks; ++i)
+    {
+        q.push(make_counter_task(counter));
+        if(i % 3 == 0 && q.pop(t))
+        {
+            (*t)();
+        }
+    }
+    while(q.pop(t))
+    {
+        (*t)();
+    }
+    while(counter.load() < tasks)
+    {
+        std::this_thread::yield();
+    }
+    done.store(true);
+    for(auto& thief : thieves)
+    {
+        thief.join();
+    }
+
+    ASSERT_EQ(tasks, counter.load());
+}